@@ -0,0 +1,369 @@
+// benchmark of wonderland.log, it writes the results in JSON to the standard output.
+//
+//   usage: benchmark [--iterations <lines per thread>] [--threads <n,n,...>]
+//
+//   cases  : filtered ( LOGD with keep_level info ), limited ( LOGW with sample 1 in 100 and 1000 lines/s ),
+//            literal ( a short literal ),
+//            mixed ( ints, floats and strings ), fields ( the same values with kv )
+//   hooks  : cerr ( the default hook, the standard error is redirected to /dev/null ),
+//            ostream ( make_string_output_hook to std::ofstream of /dev/null,
+//                      the line is formatted out of the lock and written with write_mutex ),
+//            queue ( make_string_output_hook to a pushable queue )
+//   modes  : sync, async ( overflow_policy::block ), binary ( async and binary mode )
+//
+//   latency is the time of a LOG statement in the producer thread,
+//   throughput is the lines per second of the all producers,
+//   and drained throughput includes LOG_FLUSH() to wait the async writer.
+
+#include <wonder_rabbit_project/wonderland/log.hxx>
+
+#include <fstream>
+#include <deque>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#if defined( __x86_64__ ) || defined( __i386__ )
+  #include <x86intrin.h>
+  #define WRP_WONDERLAND_LOG_BENCHMARK_RDTSC
+#endif
+
+namespace
+{
+  using namespace wonder_rabbit_project::wonderland;
+
+  // cycles of rdtsc, or nanoseconds of steady_clock if rdtsc is not available
+  inline auto ticks()
+  -> std::uint64_t
+  {
+#ifdef WRP_WONDERLAND_LOG_BENCHMARK_RDTSC
+    return __rdtsc();
+#else
+    return static_cast< std::uint64_t > ( std::chrono::duration_cast< std::chrono::nanoseconds > ( std::chrono::steady_clock::now().time_since_epoch() ).count() );
+#endif
+  }
+
+  auto ticks_per_nanosecond()
+  -> double
+  {
+#ifdef WRP_WONDERLAND_LOG_BENCHMARK_RDTSC
+    using namespace std::chrono;
+
+    const auto t0 = steady_clock::now();
+    const auto c0 = ticks();
+
+    while ( steady_clock::now() - t0 < milliseconds ( 100 ) )
+      ;
+
+    const auto c1 = ticks();
+    const auto t1 = steady_clock::now();
+
+    return static_cast< double > ( c1 - c0 ) / duration_cast< nanoseconds > ( t1 - t0 ).count();
+#else
+    return 1.0;
+#endif
+  }
+
+  auto timer_overhead()
+  -> std::uint64_t
+  {
+    std::vector< std::uint64_t > samples ( 10000 );
+
+    for ( auto& s : samples )
+    {
+      const auto c0 = ticks();
+      s = ticks() - c0;
+    }
+
+    std::sort ( samples.begin(), samples.end() );
+    return samples[ samples.size() / 2 ];
+  }
+
+  // a pushable for make_string_output_hook, it keeps the last lines only
+  struct queue_t
+  {
+    std::mutex                mutex;
+    std::deque< std::string > lines;
+
+    auto push ( std::string&& line )
+    -> void
+    {
+      std::lock_guard< std::mutex > l ( mutex );
+      lines.emplace_back ( std::move ( line ) );
+
+      if ( lines.size() > 1024 )
+        lines.pop_front();
+    }
+  };
+
+  enum class case_t { filtered, limited, literal, mixed, fields };
+  enum class hook_t { none, cerr, ostream, queue };
+  enum class logging_mode_t { sync, async, binary };
+
+  auto to_string ( case_t c ) -> const char*
+  { return c == case_t::filtered ? "filtered" : c == case_t::limited ? "limited" : c == case_t::literal ? "literal" : c == case_t::mixed ? "mixed" : "fields"; }
+
+  auto to_string ( hook_t h ) -> const char*
+  { return h == hook_t::none ? "none" : h == hook_t::cerr ? "cerr" : h == hook_t::ostream ? "ostream" : "queue"; }
+
+  auto to_string ( logging_mode_t m ) -> const char*
+  { return m == logging_mode_t::sync ? "sync" : m == logging_mode_t::async ? "async" : "binary"; }
+
+  struct result_t
+  {
+    case_t         c;
+    hook_t         hook;
+    logging_mode_t mode;
+    std::size_t    threads;
+    std::uint64_t  lines;
+    std::uint64_t  dropped;
+    std::uint64_t  p50, p99, p99_9, max;
+    double         seconds;
+    double         drained_seconds;
+  };
+
+  // each thread writes the latency of each statement into its own vector
+  auto produce ( const case_t c, const std::size_t iterations, std::vector< std::uint64_t >& latencies )
+  -> void
+  {
+    const std::string name = "wonderland";
+
+    for ( std::size_t n = 0; n < iterations; ++n )
+    {
+      const auto c0 = ticks();
+
+      switch ( c )
+      {
+        case case_t::filtered:
+          LOGD << "filtered " << n << " " << 1.5 << " " << name;
+          break;
+
+        case case_t::limited:
+          LOGW << "limited " << n << " " << 1.5 << " " << name;
+          break;
+
+        case case_t::literal:
+          LOGI << "hello, wonderland.log";
+          break;
+
+        case case_t::mixed:
+          LOGI << "n=" << n << " i=" << -12345 << " f=" << 3.14159 << " s=" << name << " c=" << 'x' << " b=" << true;
+          break;
+
+        case case_t::fields:
+          LOGI.kv ( "n", n ).kv ( "i", -12345 ).kv ( "f", 3.14159 ).kv ( "s", name ).kv ( "c", 'x' ).kv ( "b", true ) << "fields";
+          break;
+      }
+
+      latencies[ n ] = ticks() - c0;
+    }
+  }
+
+  auto run ( const case_t c, const hook_t hook, const logging_mode_t mode, const std::size_t threads, const std::size_t iterations, const log::log_t::hooks_type& hooks )
+  -> result_t
+  {
+    using namespace std::chrono;
+
+    LOG_ASYNC( false );
+    LOG_HOOKS( hooks );
+    LOG_BINARY_MODE( mode == logging_mode_t::binary );
+    LOG_KEEP_LEVEL( log::level::info );
+
+    log::limit_t limit;
+    limit.sample           = 100;
+    limit.lines_per_second = 1000;
+    LOG_LIMIT( log::level::warn, c == case_t::limited ? limit : log::limit_t() );
+
+    if ( mode != logging_mode_t::sync )
+      LOG_ASYNC( true, 8192, log::overflow_policy::block );
+
+    std::vector< std::vector< std::uint64_t > > latencies ( threads, std::vector< std::uint64_t > ( iterations ) );
+    std::vector< std::thread > producers;
+    std::atomic< std::size_t > ready ( 0 );
+    std::atomic< bool >        go ( false );
+
+    for ( std::size_t t = 0; t < threads; ++t )
+      producers.emplace_back
+      ( [ &, t ]
+        {
+          ++ready;
+
+          while ( ! go.load ( std::memory_order_acquire ) )
+            std::this_thread::yield();
+
+          produce ( c, iterations, latencies[ t ] );
+        }
+      );
+
+    while ( ready.load() != threads )
+      std::this_thread::yield();
+
+    const auto t0 = steady_clock::now();
+    go.store ( true, std::memory_order_release );
+
+    for ( auto& p : producers )
+      p.join();
+
+    const auto t1 = steady_clock::now();
+    LOG_FLUSH();
+    const auto t2 = steady_clock::now();
+
+    const auto dropped = LOG_INSTANCE.dropped_count();
+
+    LOG_ASYNC( false );
+    LOG_BINARY_MODE( false );
+
+    std::vector< std::uint64_t > all;
+    all.reserve ( threads * iterations );
+
+    for ( const auto& l : latencies )
+      all.insert ( all.end(), l.begin(), l.end() );
+
+    std::sort ( all.begin(), all.end() );
+
+    const auto percentile = [ & ] ( const double p )
+    { return all[ std::min ( all.size() - 1, static_cast< std::size_t > ( p * all.size() ) ) ]; };
+
+    return
+    { c, hook, mode, threads
+      , static_cast< std::uint64_t > ( all.size() )
+      , dropped
+      , percentile ( 0.5 ), percentile ( 0.99 ), percentile ( 0.999 ), all.back()
+      , duration_cast< duration< double > > ( t1 - t0 ).count()
+      , duration_cast< duration< double > > ( t2 - t0 ).count()
+    };
+  }
+
+  auto parse_threads ( const std::string& s )
+  -> std::vector< std::size_t >
+  {
+    std::vector< std::size_t > r;
+    std::istringstream i ( s );
+    std::string v;
+
+    while ( std::getline ( i, v, ',' ) )
+      r.push_back ( std::max< std::size_t > ( 1, std::stoul ( v ) ) );
+
+    return r;
+  }
+}
+
+auto main ( int argc, char** argv )
+-> int
+{
+  std::size_t iterations = 20000;
+  std::vector< std::size_t > thread_counts { 1, 2, 4, 8, 16 };
+
+  for ( int n = 1; n + 1 < argc; n += 2 )
+  {
+    const std::string option = argv[ n ];
+
+    if ( option == "--iterations" )
+      iterations = std::max< std::size_t > ( 1, std::stoul ( argv[ n + 1 ] ) );
+    else if ( option == "--threads" )
+      thread_counts = parse_threads ( argv[ n + 1 ] );
+  }
+
+  // the cerr hook writes to /dev/null, the results are written to the standard output
+  const auto null_fd = ::open ( "/dev/null", O_WRONLY );
+
+  if ( null_fd >= 0 )
+  {
+    ::dup2 ( null_fd, STDERR_FILENO );
+    ::close ( null_fd );
+  }
+
+  static std::ofstream null_stream ( "/dev/null" );
+  static queue_t       queue;
+
+  const auto cerr_hooks = LOG_INSTANCE.hooks();
+
+  const auto hooks_of = [ & ] ( const hook_t hook )
+  -> log::log_t::hooks_type
+  {
+    switch ( hook )
+    {
+      case hook_t::none:
+      case hook_t::cerr:
+        return cerr_hooks;
+
+      case hook_t::ostream:
+        return { log::make_string_output_hook ( static_cast< std::ostream& > ( null_stream ) ) };
+
+      case hook_t::queue:
+        return { log::make_string_output_hook ( queue ) };
+    }
+
+    return cerr_hooks;
+  };
+
+  // the login line is written before the measurements
+  LOGI << "benchmark";
+  LOG_FLUSH();
+
+  const auto ticks_per_ns = ticks_per_nanosecond();
+  const auto overhead     = timer_overhead();
+
+  std::vector< result_t > results;
+
+  for ( const auto threads : thread_counts )
+    results.emplace_back ( run ( case_t::filtered, hook_t::none, logging_mode_t::sync, threads, iterations, cerr_hooks ) );
+
+  for ( const auto threads : thread_counts )
+    results.emplace_back ( run ( case_t::limited, hook_t::none, logging_mode_t::sync, threads, iterations, cerr_hooks ) );
+
+  for ( const auto c : { case_t::literal, case_t::mixed, case_t::fields } )
+    for ( const auto hook : { hook_t::cerr, hook_t::ostream, hook_t::queue } )
+      for ( const auto mode : { logging_mode_t::sync, logging_mode_t::async, logging_mode_t::binary } )
+        for ( const auto threads : thread_counts )
+          results.emplace_back ( run ( c, hook, mode, threads, iterations, hooks_of ( hook ) ) );
+
+  LOG_HOOKS( cerr_hooks );
+
+  const auto ns = [ & ] ( const std::uint64_t t ) { return t / ticks_per_ns; };
+
+  std::printf
+  ( "{\n"
+    "  \"library\": \"wonderland.log\",\n"
+    "  \"compiler\": \"%s\",\n"
+#ifdef NDEBUG
+    "  \"ndebug\": true,\n"
+#else
+    "  \"ndebug\": false,\n"
+#endif
+#ifdef WRP_WONDERLAND_LOG_BENCHMARK_RDTSC
+    "  \"timer\": \"rdtsc\",\n"
+#else
+    "  \"timer\": \"steady_clock\",\n"
+#endif
+    "  \"cycles_per_ns\": %.4f,\n"
+    "  \"timer_overhead_cycles\": %llu,\n"
+    "  \"iterations_per_thread\": %zu,\n"
+    "  \"results\": [\n"
+    , __VERSION__
+    , ticks_per_ns
+    , static_cast< unsigned long long > ( overhead )
+    , iterations
+  );
+
+  for ( std::size_t n = 0; n < results.size(); ++n )
+  {
+    const auto& r = results[ n ];
+
+    std::printf
+    ( "    { \"case\": \"%s\", \"hook\": \"%s\", \"mode\": \"%s\", \"threads\": %zu, \"lines\": %llu, \"dropped\": %llu,\n"
+      "      \"latency_cycles\": { \"p50\": %llu, \"p99\": %llu, \"p99_9\": %llu, \"max\": %llu },\n"
+      "      \"latency_ns\": { \"p50\": %.1f, \"p99\": %.1f, \"p99_9\": %.1f, \"max\": %.1f },\n"
+      "      \"throughput_lines_per_second\": %.0f, \"drained_lines_per_second\": %.0f }%s\n"
+      , to_string ( r.c ), to_string ( r.hook ), to_string ( r.mode ), r.threads
+      , static_cast< unsigned long long > ( r.lines ), static_cast< unsigned long long > ( r.dropped )
+      , static_cast< unsigned long long > ( r.p50 ), static_cast< unsigned long long > ( r.p99 )
+      , static_cast< unsigned long long > ( r.p99_9 ), static_cast< unsigned long long > ( r.max )
+      , ns ( r.p50 ), ns ( r.p99 ), ns ( r.p99_9 ), ns ( r.max )
+      , r.lines / r.seconds, r.lines / r.drained_seconds
+      , n + 1 == results.size() ? "" : ","
+    );
+  }
+
+  std::printf ( "  ]\n}\n" );
+}
@@ -0,0 +1,199 @@
+// wonderland-log-decode: decode a binary log of make_binary_output_hook to the text layout.
+//
+//   usage: wonderland-log-decode [options] [file]
+//     --level <debug|info|warn|error|fatal>  write only the lines of the level or higher
+//     --from <seconds>                       write only the lines at or after the seconds from run
+//     --to <seconds>                         write only the lines at or before the seconds from run
+//     --time-appearance <name>               e.g. iso8601_in_microseconds ( default: f64_in_seconds_from_run )
+//     --time-format <gmt|jst>                the time format of iso8601_in_* ( default: gmt )
+//     --format <text|json|logfmt>            the encoding of the lines ( default: text )
+//   it reads the standard input if file is not given.
+
+#define WRP_WONDERLAND_LOG_NO_MACRO
+#include <wonder_rabbit_project/wonderland/log/binary.hxx>
+
+#include <fstream>
+#include <limits>
+
+namespace
+{
+  using namespace wonder_rabbit_project::wonderland;
+
+  auto usage()
+  -> int
+  {
+    std::cerr
+      << "usage: wonderland-log-decode [options] [file]\n"
+         "  --level <debug|info|warn|error|fatal>\n"
+         "  --from <seconds from run>\n"
+         "  --to <seconds from run>\n"
+         "  --time-appearance <f64_in_seconds_from_run|i64_in_*_from_epoch|iso8601_in_*>\n"
+         "  --time-format <gmt|jst>\n"
+         "  --format <text|json|logfmt>\n"
+      ;
+    return 2;
+  }
+
+  auto to_level ( const std::string& s, log::level& l )
+  -> bool
+  {
+    for ( auto v : { log::level::debug, log::level::info, log::level::warn, log::level::error, log::level::fatal } )
+      if ( log::to_string ( v ) == s )
+        return l = v, true;
+
+    return false;
+  }
+
+  auto to_time_appearance ( const std::string& s, log::time_appearance& a )
+  -> bool
+  {
+    for ( auto v :
+      { log::time_appearance::f64_in_seconds_from_run
+      , log::time_appearance::i64_in_seconds_from_epoch
+      , log::time_appearance::i64_in_milliseconds_from_epoch
+      , log::time_appearance::i64_in_microseconds_from_epoch
+      , log::time_appearance::i64_in_nanoseconds_from_epoch
+      , log::time_appearance::iso8601_in_seconds
+      , log::time_appearance::iso8601_in_milliseconds
+      , log::time_appearance::iso8601_in_microseconds
+      , log::time_appearance::iso8601_in_nanoseconds
+      }
+    )
+      if ( log::to_string ( v ) == s )
+        return a = v, true;
+
+    return false;
+  }
+
+  auto to_encoding ( const std::string& s, log::encoding& e )
+  -> bool
+  {
+    for ( auto v : { log::encoding::text, log::encoding::json, log::encoding::logfmt } )
+      if ( log::to_string ( v ) == s )
+        return e = v, true;
+
+    return false;
+  }
+
+  auto to_seconds ( const std::string& s, double& seconds )
+  -> bool
+  {
+    char* end = nullptr;
+    seconds = std::strtod ( s.c_str(), &end );
+    return ! s.empty() && *end == '\0';
+  }
+}
+
+auto main ( int argc, char** argv )
+-> int
+{
+  auto minimum_level   = log::level::debug;
+  auto from            = -std::numeric_limits< double >::infinity();
+  auto to              =  std::numeric_limits< double >::infinity();
+  auto time_appearance = log::time_appearance::f64_in_seconds_from_run;
+  auto time_format     = log::time_format::gmt;
+  auto format          = log::encoding::text;
+  std::string file;
+
+  for ( int n = 1; n < argc; ++n )
+  {
+    const std::string option = argv[ n ];
+
+    if ( option.size() > 2 && option.compare ( 0, 2, "--" ) == 0 )
+    {
+      if ( n + 1 == argc )
+        return usage();
+
+      const std::string value = argv[ ++n ];
+
+      if ( option == "--level" )
+      {
+        if ( ! to_level ( value, minimum_level ) )
+          return usage();
+      }
+      else if ( option == "--from" )
+      {
+        if ( ! to_seconds ( value, from ) )
+          return usage();
+      }
+      else if ( option == "--to" )
+      {
+        if ( ! to_seconds ( value, to ) )
+          return usage();
+      }
+      else if ( option == "--time-appearance" )
+      {
+        if ( ! to_time_appearance ( value, time_appearance ) )
+          return usage();
+      }
+      else if ( option == "--time-format" )
+      {
+        if ( value == "gmt" )
+          time_format = log::time_format::gmt;
+        else if ( value == "jst" )
+          time_format = log::time_format::jst;
+        else
+          return usage();
+      }
+      else if ( option == "--format" )
+      {
+        if ( ! to_encoding ( value, format ) )
+          return usage();
+      }
+      else
+        return usage();
+    }
+    else if ( file.empty() )
+      file = option;
+    else
+      return usage();
+  }
+
+  std::ifstream in;
+
+  if ( ! file.empty() )
+  {
+    in.open ( file, std::ios::binary );
+
+    if ( ! in )
+    {
+      std::cerr << "wonderland-log-decode: cannot open " << file << "\n";
+      return 1;
+    }
+  }
+
+  try
+  {
+    log::binary::reader_t reader ( file.empty() ? std::cin : in );
+
+    auto& context = reader.context();
+    context.time_appearance = time_appearance;
+    context.time_format     = time_format;
+
+    const auto encoder = log::encoder ( format );
+
+    log::line_buffer_t r;
+    log::log_line_t    line;
+
+    while ( reader.next ( line ) )
+    {
+      if ( line.level < minimum_level )
+        continue;
+
+      const auto seconds = std::chrono::duration_cast< std::chrono::duration< double > > ( line.time - context.start_time ).count();
+
+      if ( seconds < from || seconds > to )
+        continue;
+
+      r.clear();
+      encoder ( r, line, context );
+      std::cout.write ( r.data(), static_cast< std::streamsize > ( r.size() ) );
+    }
+  }
+  catch ( const std::exception& e )
+  {
+    std::cout.flush();
+    std::cerr << "wonderland-log-decode: " << e.what() << "\n";
+    return 1;
+  }
+}
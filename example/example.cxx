@@ -2,9 +2,10 @@
 
 // use NDEBUG macro trick if you want.
 #ifdef NDEBUG
-// to disable logger if define it.
-//   recommend: use macro usage, then disable all of features define it only.
-#define WRP_WONDERLAND_LOG_DISABLE
+// to remove lower level statements at compile-time if define it.
+//   0: none, 1: debug, 2: info, 3: warn, 4: error, 5: fatal, 6: nothing
+//   recommend: use macro usage, then the removed statements cost nothing.
+#define WRP_WONDERLAND_LOG_MIN_LEVEL 2
 #endif
 
 #include <wonder_rabbit_project/wonderland/log.hxx>
@@ -28,11 +29,65 @@ auto main()
   
   // set hook as like a `tee` with lambda-expression.
   //HOG_HOOKS( { []( log::log_line_t& log_line ) { std::ofstream( "log.txt" ) << log_line; } } );
+
+  // set hook to write a file with the buffer, it does not open the file or call write per line.
+  //   - include <wonder_rabbit_project/wonderland/log/file_sink.hxx> for make_file_output_hook.
+  //   - file_sink_options_t has buffer_size, flush_interval, rotation_size, rotation_interval,
+  //     rotated_files, mmap, mmap_chunk_size, fsync_policy and fsync_interval.
+  //   - the buffer is flushed at LOG_FLUSH(), the destructor of log_t and the if_fatal exit paths.
+  //log::file_sink_options_t file_options;
+  //file_options.path          = "log.txt";
+  //file_options.rotation_size = 64 << 20;
+  //file_options.fsync_policy  = log::fsync_policy::on_error;
+  //LOG_HOOKS( { log::make_file_output_hook( file_options ) } );
+  
+  // async mode: hooks are called on a dedicated writer thread.
+  //   - LOG_ASYNC( true [, capacity [, overflow_policy ] ] ) to enable, LOG_ASYNC( false ) to disable.
+  //   - overflow_policy is one of block ( default ), drop_newest or drop_oldest.
+  //   - LOG_FLUSH() waits until all of the logged lines are written,
+  //     and the lines are drained at the destructor and if_fatal exit paths too.
+  //LOG_ASYNC( true, 8192, log::overflow_policy::drop_oldest );
+  
+  // time appearance of the lines: f64_in_seconds_from_run ( default ),
+  //   i64_in_[seconds,milliseconds,microseconds,nanoseconds]_from_epoch
+  //   or iso8601_in_[seconds,milliseconds,microseconds,nanoseconds] in the LOG_TIME_FORMAT.
+  //LOG_TIME_APPEARANCE( log::time_appearance::iso8601_in_microseconds );
+
+  // binary mode: LOG statements encode the arguments without formatting.
+  //   - include <wonder_rabbit_project/wonderland/log/binary.hxx> for make_binary_output_hook.
+  //   - the text layout is written by `wonderland-log-decode [--level warn] [--from s] [--to s] log.bin`.
+  //   - the other hooks still work, they decode the lines at the write time.
+  //static std::ofstream binary_log( "log.bin", std::ios::binary );
+  //LOG_HOOKS( { log::make_binary_output_hook( binary_log ) } );
+  //LOG_BINARY_MODE( true );
+
+  // structured fields: kv( key, value ) adds a typed field to the line.
+  //   - the values of bool, integers and floating points are kept in the types,
+  //     strings and the other stringable objects are kept as the strings.
+  //   - encoding::text appends ` key=value`, encoding::json and encoding::logfmt write them
+  //     as the members ( e.g. make_string_output_hook( std::cout, log::encoding::json ) ).
+  //   - a hook can find a field with log_line.fields -> find( "user", field_view ).
+  //   - the fields over WRP_WONDERLAND_LOG_FIELDS_CAPACITY ( default 8 ) are dropped.
+  //LOG_HOOKS( { log::make_string_output_hook( std::cout, log::encoding::json ) } );
+  //LOGI.kv( "user", 42 ).kv( "latency_us", 12.5 ) << "request done";
+
+  // limits of each call site of the LOG macros per level ( except fatal ):
+  //   - lines_per_second and burst: token bucket, sample: 1 in N lines,
+  //     collapse: "last message repeated N times" instead of the identical consecutive lines.
+  //   - the rate and the sample are checked before the streamed values are evaluated.
+  //   - LOG_SUPPRESSED_COUNT() and log::call_site_t::for_each give the suppressed lines.
+  //log::limit_t warn_limit;
+  //warn_limit.lines_per_second = 10;
+  //warn_limit.burst            = 100;
+  //warn_limit.collapse         = 1000;
+  //LOG_LIMIT( log::level::warn, warn_limit );
   
   // logging with default level
   //   - LOG[D,I,W,E,F] generate an ostream object then put any stringable object.
   //   - LOG[D,I,W,E,F] is not defined if define WRP_WONDERLAND_LOG_NO_MACRO
-  //   - LOG[D,I,W,E,F] to nothing if define WRP_WONDERLAND_LOG_DISABLE
+  //   - LOG[D,I,W,E,F] check the level at first, then a filtered-out statement
+  //     does not evaluate the streamed values.
+  //   - LOG[D,I,W,E,F] to nothing if the level is lower than WRP_WONDERLAND_LOG_MIN_LEVEL
   LOG << "hello, " << "LOG ( logger address is " << std::hex << &LOG_INSTANCE << " ) " << "!";
   
   // change default level
@@ -26,9 +26,30 @@
 #include <iostream>
 #include <mutex>
 #include <cmath>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+#include <type_traits>
+
+#ifdef __SSE2__
+  #include <emmintrin.h>
+#endif
+
+// compile-time minimum level, statements below the level are removed entirely.
+//   0: none ( all levels are compiled ), 1: debug, 2: info, 3: warn, 4: error, 5: fatal, 6: nothing.
+//   WRP_WONDERLAND_LOG_DISABLE is an alias of 6.
+#ifndef WRP_WONDERLAND_LOG_MIN_LEVEL
+  #ifdef WRP_WONDERLAND_LOG_DISABLE
+    #define WRP_WONDERLAND_LOG_MIN_LEVEL 6
+  #else
+    #define WRP_WONDERLAND_LOG_MIN_LEVEL 0
+  #endif
+#endif
 
 #ifndef WRP_WONDERLAND_LOG_NO_MACRO
-#ifndef WRP_WONDERLAND_LOG_DISABLE
 
 #if defined( __Clang__ ) || defined( __GNUC__ )
 #define WRP_WONDERLAND_LOG_FUNCTION __PRETTY_FUNCTION__
@@ -38,16 +59,42 @@
 
 #define WRP_WONDERLAND_LOG_SOURCE_PARAMS __FILE__, __LINE__, WRP_WONDERLAND_LOG_FUNCTION
 
+// static descriptor of the statement keyed on __FILE__, __LINE__ and the function
+#define WRP_WONDERLAND_LOG_CALL_SITE \
+  wonder_rabbit_project::wonderland::log::call_site_slot_t \
+  < wonder_rabbit_project::wonderland::log::detail::hash_source_file( __FILE__, sizeof( __FILE__ ) - 1 ), __LINE__ > \
+  ::of( WRP_WONDERLAND_LOG_FUNCTION )
+
 #ifndef LOG_INSTANCE
   #define LOG_INSTANCE wonder_rabbit_project::wonderland::log::log_t::instance()
 #endif
 
-#define LOG  LOG_INSTANCE( WRP_WONDERLAND_LOG_SOURCE_PARAMS )
-#define LOGD LOG_INSTANCE( wonder_rabbit_project::wonderland::log::level::debug, WRP_WONDERLAND_LOG_SOURCE_PARAMS )
-#define LOGI LOG_INSTANCE( wonder_rabbit_project::wonderland::log::level::info , WRP_WONDERLAND_LOG_SOURCE_PARAMS )
-#define LOGW LOG_INSTANCE( wonder_rabbit_project::wonderland::log::level::warn , WRP_WONDERLAND_LOG_SOURCE_PARAMS )
-#define LOGE LOG_INSTANCE( wonder_rabbit_project::wonderland::log::level::error, WRP_WONDERLAND_LOG_SOURCE_PARAMS )
-#define LOGF LOG_INSTANCE( wonder_rabbit_project::wonderland::log::level::fatal, WRP_WONDERLAND_LOG_SOURCE_PARAMS )
+// check the level and the limits of the call site before the all of work,
+//   then the streamed values of a filtered-out statement are never evaluated.
+#define WRP_WONDERLAND_LOG_IF( condition ) \
+  ! ( condition ) ? ( void ) 0 : wonder_rabbit_project::wonderland::log::detail::voidify_t() &
+
+#define WRP_WONDERLAND_LOG_LEVEL( level_name ) \
+  WRP_WONDERLAND_LOG_IF \
+  ( wonder_rabbit_project::wonderland::log::is_compiled( wonder_rabbit_project::wonderland::log::level::level_name ) \
+    && LOG_INSTANCE.is_enabled( wonder_rabbit_project::wonderland::log::level::level_name ) \
+    && LOG_INSTANCE.admit( WRP_WONDERLAND_LOG_CALL_SITE, wonder_rabbit_project::wonderland::log::level::level_name, WRP_WONDERLAND_LOG_SOURCE_PARAMS ) \
+  ) \
+  LOG_INSTANCE( WRP_WONDERLAND_LOG_CALL_SITE, wonder_rabbit_project::wonderland::log::level::level_name, WRP_WONDERLAND_LOG_SOURCE_PARAMS )
+
+#define LOG \
+  WRP_WONDERLAND_LOG_IF \
+  ( wonder_rabbit_project::wonderland::log::is_compiled( wonder_rabbit_project::wonderland::log::level::fatal ) \
+    && LOG_INSTANCE.is_enabled() \
+    && LOG_INSTANCE.admit( WRP_WONDERLAND_LOG_CALL_SITE, WRP_WONDERLAND_LOG_SOURCE_PARAMS ) \
+  ) \
+  LOG_INSTANCE( WRP_WONDERLAND_LOG_CALL_SITE, WRP_WONDERLAND_LOG_SOURCE_PARAMS )
+
+#define LOGD WRP_WONDERLAND_LOG_LEVEL( debug )
+#define LOGI WRP_WONDERLAND_LOG_LEVEL( info  )
+#define LOGW WRP_WONDERLAND_LOG_LEVEL( warn  )
+#define LOGE WRP_WONDERLAND_LOG_LEVEL( error )
+#define LOGF WRP_WONDERLAND_LOG_LEVEL( fatal )
 
 #define LOG_DEFAULT_LEVEL( a ) LOG_INSTANCE.default_level( a )
 #define LOG_KEEP_LEVEL( a )    LOG_INSTANCE.keep_level( a )
@@ -60,31 +107,14 @@
 #define LOG_TIME_APPEARANCE( a ) LOG_INSTANCE.time_appearance( a )
 #define LOG_TIME_FORMAT( a )     LOG_INSTANCE.time_format( a )
 
-#else
-
-#ifndef LOG_INSTANCE
-  #define LOG_INSTANCE wonder_rabbit_project::wonderland::log::log_t::instance()
-#endif
-
-#define LOG  wonder_rabbit_project::wonderland::log::null_logger_t()
-#define LOGD wonder_rabbit_project::wonderland::log::null_logger_t()
-#define LOGI wonder_rabbit_project::wonderland::log::null_logger_t()
-#define LOGW wonder_rabbit_project::wonderland::log::null_logger_t()
-#define LOGE wonder_rabbit_project::wonderland::log::null_logger_t()
-#define LOGF wonder_rabbit_project::wonderland::log::null_logger_t()
+#define LOG_ASYNC( ... ) LOG_INSTANCE.async( __VA_ARGS__ )
+#define LOG_FLUSH( )     LOG_INSTANCE.flush( )
 
-#define LOG_DEFAULT_LEVEL( a ) nullptr
-#define LOG_KEEP_LEVEL( a )    nullptr
+#define LOG_BINARY_MODE( a ) LOG_INSTANCE.binary_mode( a )
 
-#define LOG_HOOK( a )        nullptr
-#define LOG_AT_DESTRUCT( a ) nullptr
+#define LOG_LIMIT( ... )         LOG_INSTANCE.limit( __VA_ARGS__ )
+#define LOG_SUPPRESSED_COUNT( )  LOG_INSTANCE.suppressed_count( )
 
-#define LOG_IF_FATAL( a )        nullptr
-#define LOG_START_TIME( a )      nullptr
-#define LOG_TIME_APPEARANCE( a ) nullptr
-#define LOG_TIME_FORMAT( a )     nullptr
-
-#endif
 #endif
 
 namespace
@@ -128,39 +158,58 @@ namespace wonder_rabbit_project
           }
          };
 #endif
+        // offset of a clock to the system_clock, it is computed once at the first call
+        //   instead of calling both now() for each conversion.
+        template < typename clock >
+        struct system_clock_offset_t
+        {
+          static auto get()
+          -> std::chrono::nanoseconds
+          {
+            static const auto offset = compute();
+            return offset;
+          }
+          
+        private:
+          static auto compute()
+          -> std::chrono::nanoseconds
+          {
+            using namespace std::chrono;
+            
+            if ( std::is_same< clock, system_clock >::value )
+              return nanoseconds( 0 );
+            
+            // the middle of two samples of the clock to reduce the error
+            const auto a = duration_cast< nanoseconds >( clock::now().time_since_epoch() );
+            const auto s = duration_cast< nanoseconds >( system_clock::now().time_since_epoch() );
+            const auto b = duration_cast< nanoseconds >( clock::now().time_since_epoch() );
+            
+            return s - ( a + ( b - a ) / 2 );
+          }
+        };
+        
+        // nanoseconds from the epoch of the system_clock
         template < typename T >
-        inline static auto to_time_t( const T& t )
+        inline static auto to_system_nanoseconds( const T& t )
+        -> std::int64_t
         {
-          using std::chrono::system_clock;
-          using std::chrono::duration_cast;
-          const auto& dt = t - T::clock::now();
-          auto et = system_clock::now() + duration_cast<system_clock::duration>( dt );
-          return std::time_t( system_clock::to_time_t( et ) );
+          using namespace std::chrono;
+          return static_cast< std::int64_t >
+            ( ( duration_cast< nanoseconds >( t.time_since_epoch() ) + system_clock_offset_t< typename T::clock >::get() ).count() );
         }
+        
+        // floor division, then the times before the epoch are also rounded to the past
+        inline static auto floor_divide( const std::int64_t a, const std::int64_t b )
+        -> std::int64_t
+        { return a / b - ( a % b < 0 ? 1 : 0 ); }
 
 #ifdef _WIN32
           // TDM-GCC-5.1.0 is not support %F and %T
           //   note: mingw is supported. but we cannot predicate TDM or not.
-        constexpr auto format_date_time_gmt = "%Y-%m-%dT%H:%M:%SZ";
         constexpr auto format_date_time     = "%Y-%m-%dT%H:%M:%S";
 #else
-        constexpr auto format_date_time_gmt = "%FT%TZ";
         constexpr auto format_date_time     = "%FT%T";
 #endif
-        constexpr auto format_time_zone = "%H:%M";
-        
-        template < typename T >
-        inline static auto to_string_iso8601_gmt ( const T& t = T::clock::now() )
-        {
-          using namespace std::chrono;
-        
-          const time_t& ct = detail::to_time_t( t );
-        
-          std::string r = "0000-00-00T00:00:00Z.";
-          std::strftime ( const_cast< char* > ( r.data( ) ), r.size( ), format_date_time_gmt, std::gmtime ( &ct ) );
-        
-          return r;
-        }
         
         template < typename T = std::chrono::minutes >
         inline static auto time_zone_difference()
@@ -171,29 +220,125 @@ namespace wonder_rabbit_project
           return std::chrono::duration_cast< T >( std::chrono::duration< double >( difftime( current_time, utc_time ) ) );
         }
         
-        template < typename T >
-        inline static auto to_string_iso8601_jst ( const T& t = T::clock::now() )
+        // thread-safe gmtime / localtime
+        inline static auto to_tm( const std::time_t t, const bool local )
+        -> std::tm
         {
-          using namespace std::chrono;
+          std::tm r;
+#ifdef _WIN32
+          if ( local )
+            localtime_s( &r, &t );
+          else
+            gmtime_s( &r, &t );
+#else
+          if ( local )
+            localtime_r( &t, &r );
+          else
+            gmtime_r( &t, &r );
+#endif
+          return r;
+        }
+        
+        // per-thread cache of the date, time and time zone parts of ISO-8601.
+        //   they are recomputed once per second, and the fractional digits are rendered for each call.
+        struct iso8601_cache_t
+        {
+          static constexpr std::size_t max_size = 19 + 1 + 9 + 6;
           
-          const time_t ct = detail::to_time_t( t );
+          std::int64_t second;
+          char         date_time[ 20 ];
+          char         zone[ 7 ];
+          std::size_t  zone_size;
           
-          std::string r = "0000-00-00T00:00:00.";
-          std::strftime ( const_cast< char* > ( r.data( ) ), r.size( ), format_date_time, std::localtime ( &ct ) );
+          auto update( const std::int64_t s, const time_format f )
+          -> void
+          {
+            const auto local = f == time_format::jst;
+            const auto t     = static_cast< std::time_t >( s );
+            const auto tm    = to_tm( t, local );
+            
+            std::strftime( date_time, sizeof( date_time ), format_date_time, &tm );
+            
+            if ( ! local )
+            {
+              zone[ 0 ] = 'Z';
+              zone_size = 1;
+            }
+            else
+            {
+#if defined( _WIN32 ) || defined( EMSCRIPTEN )
+              const auto z = static_cast< long >( time_zone_difference().count() );
+#else
+              const auto z = static_cast< long >( tm.tm_gmtoff / 60 );
+#endif
+              const auto a = std::abs( z );
+              zone[ 0 ] = z < 0 ? '-' : '+';
+              zone[ 1 ] = static_cast< char >( '0' + a / 600 % 10 );
+              zone[ 2 ] = static_cast< char >( '0' + a / 60 % 10 );
+              zone[ 3 ] = ':';
+              zone[ 4 ] = static_cast< char >( '0' + a % 60 / 10 );
+              zone[ 5 ] = static_cast< char >( '0' + a % 10 );
+              zone_size = 6;
+            }
+            
+            second = s;
+          }
+        };
+        
+        // render ISO-8601 with 0 ( seconds ), 3, 6 or 9 fractional digits into out, then return the size.
+        //   out must have iso8601_cache_t::max_size bytes at least.
+        inline static auto render_iso8601( char* out, const std::int64_t nanoseconds, const time_format f, const int fraction_digits )
+        -> std::size_t
+        {
+          thread_local iso8601_cache_t caches[ 2 ] = { { INT64_MIN, { }, { }, 0 }, { INT64_MIN, { }, { }, 0 } };
           
-          const auto z = time_zone_difference();
+          auto& c = caches[ f == time_format::jst ? 1 : 0 ];
           
-          std::stringstream rz;
-          rz
-            << ( std::signbit( z.count() ) ? "-" : "+" )
-            << std::setw( 2 ) << std::setfill( '0' )
-            << std::to_string( std::abs( duration_cast<hours>(z).count() ) )
-            << ":"
-            << std::setw( 2 ) << std::setfill( '0' )
-            << std::to_string( std::abs( duration_cast<minutes>(z).count() ) % 60 )
-            ;
+          const auto s = floor_divide( nanoseconds, 1000000000 );
           
-          return std::string( r.data(), r.data() + r.size() - 1 ) + rz.str();
+          if ( s != c.second )
+            c.update( s, f );
+          
+          auto p = out;
+          std::memcpy( p, c.date_time, 19 );
+          p += 19;
+          
+          if ( fraction_digits > 0 )
+          {
+            auto fraction = nanoseconds - s * 1000000000;
+            
+            for ( auto n = fraction_digits; n < 9; ++n )
+              fraction /= 10;
+            
+            *p = '.';
+            
+            for ( auto n = fraction_digits; n > 0; --n )
+            {
+              p[ n ] = static_cast< char >( '0' + fraction % 10 );
+              fraction /= 10;
+            }
+            
+            p += 1 + fraction_digits;
+          }
+          
+          std::memcpy( p, c.zone, c.zone_size );
+          p += c.zone_size;
+          
+          return static_cast< std::size_t >( p - out );
+        }
+        
+        template < typename T >
+        inline static auto to_string_iso8601_gmt ( const T& t = T::clock::now() )
+        {
+          char r[ iso8601_cache_t::max_size ];
+          return std::string( r, render_iso8601( r, to_system_nanoseconds( t ), time_format::gmt, 0 ) );
+        }
+        
+        template < typename T >
+        inline static auto to_string_iso8601_jst ( const T& t = T::clock::now() )
+        {
+          char r[ iso8601_cache_t::max_size ];
+          return std::string( r, render_iso8601( r, to_system_nanoseconds( t ), time_format::jst, 0 ) );
         }
         
         template < typename T >
@@ -231,6 +376,13 @@ namespace wonder_rabbit_project
         , fatal = 5
       };
       
+      constexpr std::uint8_t min_level = WRP_WONDERLAND_LOG_MIN_LEVEL;
+      
+      // false if the level is removed at compile-time by WRP_WONDERLAND_LOG_MIN_LEVEL
+      constexpr auto is_compiled ( const level l )
+      -> bool
+      { return std::uint8_t ( l ) >= min_level; }
+      
       template < class T = void >
       auto to_string ( level ) -> std::string;
       template < class T = void >
@@ -254,8 +406,66 @@ namespace wonder_rabbit_project
       {
         f64_in_seconds_from_run
         , i64_in_seconds_from_epoch
+        , i64_in_milliseconds_from_epoch
+        , i64_in_microseconds_from_epoch
+        , i64_in_nanoseconds_from_epoch
+        // ISO-8601 in the time_format, e.g. 2014-12-31T23:59:59.123Z
+        , iso8601_in_seconds
+        , iso8601_in_milliseconds
+        , iso8601_in_microseconds
+        , iso8601_in_nanoseconds
+      };
+
+      template < class T = void >
+      auto to_string ( time_appearance ) -> std::string;
+      template < class T = void >
+      auto operator<< ( std::ostream& o, time_appearance ) -> std::ostream&;
+      
+      // behavior of the async mode if the ring buffer is full
+      enum class overflow_policy
+        : std::uint8_t
+      {
+        block
+        , drop_newest
+        , drop_oldest
+      };
+
+      template < class T = void >
+      auto to_string ( overflow_policy ) -> std::string;
+      template < class T = void >
+      auto operator<< ( std::ostream& o, overflow_policy ) -> std::ostream&;
+
+      // type of a structured field of a line
+      enum class field_type
+        : std::uint8_t
+      {
+        string
+        , boolean
+        , i64
+        , u64
+        , f64
+      };
+
+      template < class T = void >
+      auto to_string ( field_type ) -> std::string;
+      template < class T = void >
+      auto operator<< ( std::ostream& o, field_type ) -> std::ostream&;
+
+      // layout of a line written by the encoders
+      enum class encoding
+        : std::uint8_t
+      {
+        // the tab-separated layout of to_string( log_line_t ), the fields are appended as logfmt
+        text
+        , json
+        , logfmt
       };
 
+      template < class T = void >
+      auto to_string ( encoding ) -> std::string;
+      template < class T = void >
+      auto operator<< ( std::ostream& o, encoding ) -> std::ostream&;
+
       struct fatal_exception
         : public std::runtime_error
       {
@@ -266,227 +476,2293 @@ namespace wonder_rabbit_project
       
       class log_stream_t;
       
-      struct log_line_t
+      // non-owning view of a string ( std::string_view is C++17 )
+      class string_view_t
       {
-        std::chrono::time_point< clock_t > time;
-        log::level    level;
-        std::string   source_file;
-        std::uint32_t source_line;
-        std::string   source_function;
-        std::string   message;
+        const char* _data;
+        std::size_t _size;
+        
+      public:
+        constexpr string_view_t ( )
+          : _data ( "" )
+          , _size ( 0 )
+        { }
+        
+        constexpr string_view_t ( const char* data, const std::size_t size )
+          : _data ( data )
+          , _size ( size )
+        { }
+        
+        string_view_t ( const char* data )
+          : _data ( data ? data : "" )
+          , _size ( data ? std::strlen ( data ) : 0 )
+        { }
+        
+        string_view_t ( const std::string& s )
+          : _data ( s.data() )
+          , _size ( s.size() )
+        { }
+        
+        constexpr auto data() const -> const char* { return _data; }
+        constexpr auto size() const -> std::size_t { return _size; }
+        constexpr auto empty() const -> bool { return _size == 0; }
+        constexpr auto begin() const -> const char* { return _data; }
+        constexpr auto end() const -> const char* { return _data + _size; }
+        
+        auto to_string() const
+        -> std::string
+        { return std::string ( _data, _size ); }
+        
+        operator std::string() const
+        { return to_string(); }
       };
       
       template < class T = void >
-      auto to_string ( const log_line_t& ) -> std::string;
-      template < class T = void >
-      auto operator<< ( std::ostream& o, const log_line_t& ) -> std::ostream&;
+      auto operator<< ( std::ostream& o, const string_view_t& ) -> std::ostream&;
       
-      class log_t final
+#ifndef WRP_WONDERLAND_LOG_LINE_BUFFER_SIZE
+  #define WRP_WONDERLAND_LOG_LINE_BUFFER_SIZE 512
+#endif
+      
+      // fixed-capacity character buffer with spill-over to the heap only for huge lines.
+      //   integers, floating points and strings are formatted without iostreams,
+      //   the other values and manipulators are through an ostream writing into the buffer.
+      class line_buffer_t
       {
-        friend class  log_stream_t;
-        friend struct log_line_t;
-        
       public:
-        using hook_type          = std::function < auto ( log_line_t& ) -> void >;
-        using hooks_type         = std::vector< hook_type >;
-        using destruct_hook_type = std::function < auto ( ) -> void >;
+        static constexpr std::size_t inline_capacity = WRP_WONDERLAND_LOG_LINE_BUFFER_SIZE;
+        // a spilled heap buffer larger than it is released by clear()
+        static constexpr std::size_t retained_capacity = inline_capacity * 64;
         
-        class log_stream_t
+      private:
+        class streambuf_t final
+          : public std::streambuf
         {
-          log_t& _master;
-          const level  _level;
-          const std::string&  _source_file;
-          const std::uint32_t _source_line;
-          const std::string&  _source_function;
-          const std::shared_ptr<std::ostringstream> _stream;
+          line_buffer_t& _buffer;
           
         public:
-          template<class T>
-          auto operator<< ( const T& value )
-          -> log_stream_t&
+          explicit streambuf_t ( line_buffer_t& buffer )
+            : _buffer ( buffer )
+          { }
+          
+        protected:
+          auto overflow ( int_type c )
+          -> int_type override
           {
-            ( *_stream ) << value;
-            return *this;
+            if ( ! traits_type::eq_int_type ( c, traits_type::eof() ) )
+              _buffer.append ( traits_type::to_char_type ( c ) );
+            
+            return traits_type::not_eof ( c );
           }
           
-          explicit log_stream_t
-          ( log_t&              master
-            , const level         level
-            , const std::string&& source_file
-            , const std::uint32_t source_line
-            , const std::string&& source_function
-          )
-            : _master ( master )
-            , _level ( level )
-            , _source_file ( std::move ( source_file ) )
-            , _source_line ( source_line )
-            , _source_function ( std::move ( source_function ) )
-            , _stream ( new std::ostringstream() )
-          { }
-          
-          ~log_stream_t()
+          auto xsputn ( const char* s, std::streamsize n )
+          -> std::streamsize override
           {
-            try
-            {
-              _master._append
-              ( { clock_t::now()
-                  , _level
-                  , _source_file
-                  , _source_line
-                  , _source_function
-                  , _stream -> str()
-                }
-              );
-            }
-            catch ( const std::exception& e )
-            {
-              std::cerr
-                  << "[WARNING] occurred exception, but here is a destructor of log_stream_t class."
-                  " then the exception reserve the next log_t any function call timing.\n"
-                  "  exception type name: " << typeid ( e ).name() << "\n"
-                  "  exception what     : " << e.what() << "\n"
-                  ;
-#ifndef EMSCRIPTEN
-              _master._exception_ptr = std::current_exception();
-#else
-              _master._pseudo_exception_ptr.reset ( new fatal_exception ( e.what() ) );
-#endif
-            }
-            catch ( ... )
-            {
-              std::cerr
-                  << "[WARNING] occurred exception, but here is a destructor of log_stream_t class."
-                  " then the exception reserve the next log_t any function call timing.\n"
-                  "  exception type name: ... \n"
-                  "  exception what     : \n"
-                  ;
-#ifndef EMSCRIPTEN
-              _master._exception_ptr = std::current_exception();
-#else
-              _master._pseudo_exception_ptr.reset ( new fatal_exception ( "..." ) );
-#endif
-            }
+            _buffer.append ( s, static_cast< std::size_t > ( n ) );
+            return n;
           }
         };
         
-      private:
-      
-        level   _default_level;
-        level   _keep_level;
-        
-        hooks_type         _hooks;
-        destruct_hook_type _at_destruct_hook;
-        
-        const clock_t::time_point _start_time;
-        log::time_appearance _time_appearance;
-        log::time_format     _time_format;
-        
-        log::if_fatal      _if_fatal;
-#ifndef EMSCRIPTEN
-        std::exception_ptr _exception_ptr;
-#else
-        std::unique_ptr< fatal_exception > _pseudo_exception_ptr;
-#endif
+        static constexpr auto default_flags = std::ios_base::skipws | std::ios_base::dec;
+        static constexpr std::streamsize default_precision = 6;
         
-        std::function < auto ( log_line_t&& line ) -> void > _append;
+        std::array< char, inline_capacity > _inline;
+        std::string  _spill;
+        char*        _data;
+        std::size_t  _size;
+        std::size_t  _capacity;
+        streambuf_t  _streambuf;
+        std::ostream _stream;
         
-        log_t( )
-          : _default_level ( level::info )
-          , _keep_level ( level::debug )
-          , _hooks
-            (
+        auto grow ( const std::size_t n )
+        -> void
         {
-          [ ] ( log_line_t& log_line )
+          const auto capacity = std::max ( _capacity * 2, _size + n );
+          
+          if ( _data == _inline.data() )
           {
-            std::lock_guard<std::mutex> l ( write_mutex );
-            std::cerr << log_line;
+            _spill.resize ( capacity );
+            std::memcpy ( &_spill[ 0 ], _data, _size );
           }
+          else
+            _spill.resize ( capacity );
+          
+          _data     = &_spill[ 0 ];
+          _capacity = capacity;
         }
-          )
-        , _at_destruct_hook ( [ ]( ) { } )
-        , _start_time ( clock_t::now() )
-        , _time_appearance ( log::time_appearance::f64_in_seconds_from_run )
-        , _time_format ( log::time_format::gmt )
-        , _if_fatal ( log::if_fatal::none )
-#ifndef EMSCRIPTEN
-        , _exception_ptr ( nullptr )
-#else
-        , _pseudo_exception_ptr ( nullptr )
-#endif
+        
+        static auto format_decimal ( char* end, std::uint64_t value )
+        -> char*
         {
-          const auto append_default = [ this ]
-                                      ( log_line_t&& line )
+          static constexpr char digit_pairs[] =
+            "00010203040506070809"
+            "10111213141516171819"
+            "20212223242526272829"
+            "30313233343536373839"
+            "40414243444546474849"
+            "50515253545556575859"
+            "60616263646566676869"
+            "70717273747576777879"
+            "80818283848586878889"
+            "90919293949596979899"
+            ;
+          
+          while ( value >= 100 )
           {
-            this -> rethrow();
-            
-            if ( std::uint8_t ( line.level ) >= std::uint8_t ( this -> _keep_level ) )
-              for ( const auto& hook : this -> _hooks )
-                hook ( line );
-                
-            if ( line.level == level::fatal )
-            {
-              std::cerr << "[WARNING] detect a `fatal` level log and the if_fatal flag is ";
-              
-              switch ( this -> _if_fatal )
-              {
-                case log::if_fatal::none:
-                  std::cerr << " `if_fatal::none` then nothing to do.\n";
-                  break;
-                  
-                case log::if_fatal::exit:
-                  std::cerr << " `if_fatal::exit` then call std::exit( EXIT_FAILURE ) now.\n";
-                  std::exit ( EXIT_FAILURE );
-                  
-                case log::if_fatal::quick_exit:
-                  std::cerr << " `if_fatal::quick_exit` then call std::quick_exit( EXIT_FAILURE ) now.\n";
-#if defined( EMSCRIPTEN ) || defined( __MINGW32__ )
-                  std::cerr
-                      << "[WARNING] Emscripten or MINGW is not support std::quick_exit yet,"
-                      " then call std::exit alternatively.\n"
-                      ;
-                  std::exit ( EXIT_FAILURE );
-#else
-                  std::quick_exit ( EXIT_FAILURE );
-#endif
-                  
-                case log::if_fatal::exception:
-                  std::cerr << " `if_fatal::exception` then throw fatal_exception now.\n";
-                  throw fatal_exception ( to_string ( line ) );
-              }
-            }
-          };
-          _append = [ this, append_default ]
-                    ( log_line_t&& line )
-          {
-            append_default
-            ( { _start_time
-                , level::info
-                , ""
-                , 0
-                , ""
-                , std::string ( "login time: " ) + detail::to_string_iso8601( _start_time, _time_format )
-              }
-            );
-            append_default ( std::move ( line ) );
-            this -> _append = append_default;
-          };
+            const auto n = static_cast< std::size_t > ( value % 100 ) * 2;
+            value /= 100;
+            *--end = digit_pairs[ n + 1 ];
+            *--end = digit_pairs[ n ];
+          }
+          
+          if ( value >= 10 )
+          {
+            const auto n = static_cast< std::size_t > ( value ) * 2;
+            *--end = digit_pairs[ n + 1 ];
+            *--end = digit_pairs[ n ];
+          }
+          else
+            *--end = static_cast< char > ( '0' + value );
+          
+          return end;
         }
         
-        log_t ( const log_t& ) = delete;
-        log_t ( log_t&& ) = delete;
-        
-        auto operator= ( const log_t& ) -> void = delete;
-        auto operator= ( log_t&& ) -> void = delete;
-        
-        auto rethrow() const
+        template < class T >
+        auto append_integer ( const T value, std::true_type /* is_signed */ )
         -> void
         {
-#ifndef EMSCRIPTEN
+          char b[ 24 ];
+          auto e = b + sizeof( b );
+          const auto u = static_cast< std::uint64_t > ( value );
+          auto p = format_decimal ( e, value < 0 ? 0 - u : u );
+          
+          if ( value < 0 )
+            *--p = '-';
+          
+          append ( p, static_cast< std::size_t > ( e - p ) );
+        }
         
-          if ( _exception_ptr != nullptr )
-            std::rethrow_exception ( _exception_ptr );
+        template < class T >
+        auto append_integer ( const T value, std::false_type /* is_signed */ )
+        -> void
+        {
+          char b[ 24 ];
+          auto e = b + sizeof( b );
+          auto p = format_decimal ( e, value );
+          append ( p, static_cast< std::size_t > ( e - p ) );
+        }
+        
+        template < class T >
+        auto append_floating ( const T value, const char* format )
+        -> void
+        {
+          char b[ 64 ];
+          const auto n = std::snprintf ( b, sizeof( b ), format, static_cast< int > ( _stream.precision() ), value );
+          
+          if ( n > 0 && static_cast< std::size_t > ( n ) < sizeof( b ) )
+            append ( b, static_cast< std::size_t > ( n ) );
+          else
+            _stream << value;
+        }
+        
+      public:
+        template < class T >
+        using is_character = std::integral_constant
+          < bool
+          , std::is_same< T, char >::value
+            || std::is_same< T, signed char >::value
+            || std::is_same< T, unsigned char >::value
+            || std::is_same< T, wchar_t >::value
+            || std::is_same< T, char16_t >::value
+            || std::is_same< T, char32_t >::value
+          >;
+        
+        template < class T >
+        using is_fast_integer = std::integral_constant
+          < bool
+          , std::is_integral< T >::value && ! is_character< T >::value && ! std::is_same< T, bool >::value
+          >;
+        
+        template < class T >
+        using is_fast = std::integral_constant
+          < bool
+          , std::is_arithmetic< T >::value
+            || std::is_same< typename std::decay< T >::type, const char* >::value
+            || std::is_same< typename std::decay< T >::type, char* >::value
+            || std::is_same< T, std::string >::value
+            || std::is_same< T, string_view_t >::value
+          >;
+        
+        // the fast formatters are available if the ostream keeps the default format
+        auto is_default_format() const
+        -> bool
+        { return _stream.flags() == default_flags && _stream.width() == 0; }
+        
+        line_buffer_t()
+          : _data ( nullptr )
+          , _size ( 0 )
+          , _capacity ( inline_capacity )
+          , _streambuf ( *this )
+          , _stream ( &_streambuf )
+        { _data = _inline.data(); }
+        
+        line_buffer_t ( const line_buffer_t& ) = delete;
+        auto operator= ( const line_buffer_t& ) -> void = delete;
+        
+        // empty the buffer and reset the format of the ostream
+        auto clear()
+        -> void
+        {
+          _size = 0;
+          
+          if ( _capacity > retained_capacity )
+          {
+            std::string().swap ( _spill );
+            _data     = _inline.data();
+            _capacity = inline_capacity;
+          }
+          
+          _stream.clear();
+          _stream.flags ( default_flags );
+          _stream.precision ( default_precision );
+          _stream.width ( 0 );
+          _stream.fill ( ' ' );
+        }
+        
+        auto append ( const char* s, const std::size_t n )
+        -> void
+        {
+          if ( _size + n > _capacity )
+            grow ( n );
+          
+          std::memcpy ( _data + _size, s, n );
+          _size += n;
+        }
+        
+        auto append ( const char c )
+        -> void
+        {
+          if ( _size == _capacity )
+            grow ( 1 );
+          
+          _data[ _size++ ] = c;
+        }
+        
+        // append the character n times
+        auto append ( const std::size_t n, const char c )
+        -> void
+        {
+          if ( _size + n > _capacity )
+            grow ( n );
+          
+          std::memset ( _data + _size, c, n );
+          _size += n;
+        }
+        
+        // same as std::fixed and std::setprecision( precision )
+        auto append_fixed ( const double value, const int precision = 6 )
+        -> void
+        {
+          char b[ 64 ];
+          const auto n = std::snprintf ( b, sizeof( b ), "%.*f", precision, value );
+          
+          if ( n > 0 && static_cast< std::size_t > ( n ) < sizeof( b ) )
+            append ( b, static_cast< std::size_t > ( n ) );
+          else
+            _stream << std::fixed << std::setprecision ( precision ) << value << std::defaultfloat << std::setprecision ( default_precision );
+        }
+        
+        // the shortest of %.15g, %.16g and %.17g which is read back to the same value
+        auto append_round_trip ( const double value )
+        -> void
+        {
+          char b[ 32 ];
+          int  n = 0;
+          
+          for ( int precision = 15; precision <= 17; ++precision )
+          {
+            n = std::snprintf ( b, sizeof( b ), "%.*g", precision, value );
+            
+            if ( ! std::isfinite ( value ) || std::strtod ( b, nullptr ) == value )
+              break;
+          }
+          
+          append ( b, static_cast< std::size_t > ( n ) );
+        }
+        
+        auto data() -> char* { return _data; }
+        auto data() const -> const char* { return _data; }
+        auto size() const -> std::size_t { return _size; }
+        auto view() const -> string_view_t { return { _data, _size }; }
+        
+        // the ostream writes into the buffer
+        auto stream()
+        -> std::ostream&
+        { return _stream; }
+        
+        auto is_default_precision() const
+        -> bool
+        { return _stream.precision() == default_precision; }
+        
+        auto operator<< ( const string_view_t& value )
+        -> line_buffer_t&
+        {
+          if ( is_default_format() )
+            append ( value.data(), value.size() );
+          else
+            _stream.write ( value.data(), static_cast< std::streamsize > ( value.size() ) );
+          
+          return *this;
+        }
+        
+        auto operator<< ( const std::string& value )
+        -> line_buffer_t&
+        { return *this << string_view_t ( value ); }
+        
+        auto operator<< ( const char* value )
+        -> line_buffer_t&
+        {
+          if ( ! value )
+            return *this;
+          
+          if ( is_default_format() )
+            append ( value, std::strlen ( value ) );
+          else
+            _stream << value;
+          
+          return *this;
+        }
+        
+        template < class T >
+        auto operator<< ( const T value )
+        -> typename std::enable_if< std::is_arithmetic< T >::value, line_buffer_t& >::type
+        {
+          if ( ! is_default_format() || ( is_character< T >::value && ! std::is_same< T, char >::value ) )
+            _stream << value;
+          else if ( std::is_same< T, char >::value )
+            append ( static_cast< char > ( value ) );
+          else if ( std::is_same< T, bool >::value )
+            append ( value ? '1' : '0' );
+          else if ( is_fast_integer< T >::value )
+            append_integer ( value, std::integral_constant< bool, std::is_signed< T >::value >() );
+          else if ( ! is_default_precision() )
+            _stream << value;
+          else if ( std::is_same< T, long double >::value )
+            append_floating ( static_cast< long double > ( value ), "%.*Lg" );
+          else
+            append_floating ( static_cast< double > ( value ), "%.*g" );
+          
+          return *this;
+        }
+        
+        // the other values through the ostream
+        template < class T >
+        auto operator<< ( const T& value )
+        -> typename std::enable_if< ! is_fast< T >::value, line_buffer_t& >::type
+        {
+          _stream << value;
+          return *this;
+        }
+        
+        auto operator<< ( std::ios_base& ( *manipulator ) ( std::ios_base& ) )
+        -> line_buffer_t&
+        {
+          _stream << manipulator;
+          return *this;
+        }
+        
+        auto operator<< ( std::ostream& ( *manipulator ) ( std::ostream& ) )
+        -> line_buffer_t&
+        {
+          _stream << manipulator;
+          return *this;
+        }
+      };
+      
+#ifndef WRP_WONDERLAND_LOG_FIELDS_CAPACITY
+  #define WRP_WONDERLAND_LOG_FIELDS_CAPACITY 8
+#endif
+      
+      // a structured field, key and string are views of the fields_t
+      struct field_view_t
+      {
+        string_view_t key;
+        field_type    type;
+        bool          boolean;
+        std::int64_t  i64;
+        std::uint64_t u64;
+        double        f64;
+        string_view_t string;
+      };
+      
+      // typed key-value fields of a line in a fixed-capacity inline array.
+      //   the keys and the string values are copied into the storage and the fields refer them by the offsets,
+      //   then it does not allocate in the steady state and copies as a value.
+      //   the fields over the capacity are counted by dropped_count() and ignored.
+      class fields_t
+      {
+      public:
+        static constexpr std::size_t capacity = WRP_WONDERLAND_LOG_FIELDS_CAPACITY;
+        
+      private:
+        struct range_t
+        {
+          std::uint32_t offset;
+          std::uint32_t size;
+        };
+        
+        struct field_t
+        {
+          range_t    key;
+          field_type type;
+          union
+          {
+            bool          boolean;
+            std::int64_t  i64;
+            std::uint64_t u64;
+            double        f64;
+            range_t       string;
+          } value;
+        };
+        
+        std::array< field_t, capacity > _fields;
+        std::size_t _size    = 0;
+        std::size_t _dropped = 0;
+        std::string _storage;
+        
+        auto store ( const string_view_t& s )
+        -> range_t
+        {
+          const range_t r { static_cast< std::uint32_t > ( _storage.size() ), static_cast< std::uint32_t > ( s.size() ) };
+          _storage.append ( s.data(), s.size() );
+          return r;
+        }
+        
+        auto view ( const range_t& r ) const
+        -> string_view_t
+        { return string_view_t ( _storage.data() + r.offset, r.size ); }
+        
+        auto push ( const string_view_t& key, const field_type type )
+        -> field_t*
+        {
+          if ( _size == capacity )
+          {
+            ++_dropped;
+            return nullptr;
+          }
+          
+          auto& f = _fields[ _size++ ];
+          f.key  = store ( key );
+          f.type = type;
+          return &f;
+        }
+        
+      public:
+        auto clear()
+        -> void
+        {
+          _size    = 0;
+          _dropped = 0;
+          _storage.clear();
+        }
+        
+        auto add ( const string_view_t& key, const string_view_t& value )
+        -> void
+        {
+          if ( auto f = push ( key, field_type::string ) )
+            f -> value.string = store ( value );
+        }
+        
+        auto add ( const string_view_t& key, const std::string& value )
+        -> void
+        { add ( key, string_view_t ( value ) ); }
+        
+        auto add ( const string_view_t& key, const char* value )
+        -> void
+        { add ( key, string_view_t ( value ? value : "" ) ); }
+        
+        template < class T >
+        auto add ( const string_view_t& key, const T value )
+        -> typename std::enable_if< std::is_arithmetic< T >::value >::type
+        {
+          if ( std::is_same< T, bool >::value )
+          {
+            if ( auto f = push ( key, field_type::boolean ) )
+              f -> value.boolean = value != T ( 0 );
+          }
+          else if ( std::is_same< T, char >::value )
+          {
+            const char c = static_cast< char > ( value );
+            add ( key, string_view_t ( &c, 1 ) );
+          }
+          else if ( std::is_floating_point< T >::value )
+          {
+            if ( auto f = push ( key, field_type::f64 ) )
+              f -> value.f64 = static_cast< double > ( value );
+          }
+          else if ( std::is_signed< T >::value )
+          {
+            if ( auto f = push ( key, field_type::i64 ) )
+              f -> value.i64 = static_cast< std::int64_t > ( value );
+          }
+          else if ( auto f = push ( key, field_type::u64 ) )
+            f -> value.u64 = static_cast< std::uint64_t > ( value );
+        }
+        
+        // the other types are stored as the string formatted by operator<<
+        template < class T >
+        auto add ( const string_view_t& key, const T& value )
+        -> typename std::enable_if< ! line_buffer_t::is_fast< T >::value >::type
+        {
+          line_buffer_t b;
+          b << value;
+          add ( key, b.view() );
+        }
+        
+        auto size() const
+        -> std::size_t
+        { return _size; }
+        
+        auto empty() const
+        -> bool
+        { return _size == 0; }
+        
+        auto dropped_count() const
+        -> std::size_t
+        { return _dropped; }
+        
+        auto operator[] ( const std::size_t n ) const
+        -> field_view_t
+        {
+          const auto& f = _fields[ n ];
+          field_view_t r { view ( f.key ), f.type, false, 0, 0, 0.0, string_view_t() };
+          
+          switch ( f.type )
+          {
+            case field_type::string : r.string  = view ( f.value.string ); break;
+            case field_type::boolean: r.boolean = f.value.boolean; break;
+            case field_type::i64    : r.i64     = f.value.i64; break;
+            case field_type::u64    : r.u64     = f.value.u64; break;
+            case field_type::f64    : r.f64     = f.value.f64; break;
+          }
+          
+          return r;
+        }
+        
+        // find the first field of the key
+        auto find ( const string_view_t& key, field_view_t& field ) const
+        -> bool
+        {
+          for ( std::size_t n = 0; n < _size; ++n )
+          {
+            const auto k = view ( _fields[ n ].key );
+            
+            if ( k.size() == key.size() && std::memcmp ( k.data(), key.data(), k.size() ) == 0 )
+            {
+              field = ( *this ) [ n ];
+              return true;
+            }
+          }
+          
+          return false;
+        }
+      };
+      
+      namespace detail
+      {
+        struct message_buffer_tag;
+        struct output_buffer_tag;
+        struct fields_buffer_tag;
+        struct decode_buffer_tag;
+        
+        // lease of the per-thread reusable line_buffer_t ( or fields_t ).
+        //   if the buffer of the thread is in use ( e.g. a log statement in operator<< of a value
+        //   or in a hook ) or already destructed ( e.g. logging in destructors of static objects ),
+        //   a heap buffer is used for the nested one.
+        template < class tag, class buffer_type = line_buffer_t >
+        class thread_buffer_t
+        {
+          // trivially destructible, then it is available after the slot is destructed
+          static auto destructed()
+          -> bool&
+          {
+            thread_local bool d = false;
+            return d;
+          }
+          
+          struct slot_t
+          {
+            buffer_type buffer;
+            bool        in_use = false;
+            
+            ~slot_t() { destructed() = true; }
+          };
+          
+          static auto slot()
+          -> slot_t&
+          {
+            thread_local slot_t s;
+            return s;
+          }
+          
+          buffer_type* _buffer;
+          std::unique_ptr< buffer_type > _nested;
+          
+        public:
+          explicit thread_buffer_t ( const bool acquire = true )
+            : _buffer ( nullptr )
+          {
+            if ( acquire )
+              this -> acquire();
+          }
+          
+          thread_buffer_t ( thread_buffer_t&& a )
+            : _buffer ( a._buffer )
+            , _nested ( std::move ( a._nested ) )
+          { a._buffer = nullptr; }
+          
+          thread_buffer_t ( const thread_buffer_t& ) = delete;
+          auto operator= ( const thread_buffer_t& ) -> void = delete;
+          
+          ~thread_buffer_t()
+          {
+            if ( _buffer && ! _nested )
+              slot().in_use = false;
+          }
+          
+          // acquire the buffer if it is not acquired yet
+          auto acquire()
+          -> void
+          {
+            if ( _buffer )
+              return;
+            
+            if ( destructed() || slot().in_use )
+            {
+              _nested.reset ( new buffer_type );
+              _buffer = _nested.get();
+            }
+            else
+            {
+              auto& s = slot();
+              s.in_use = true;
+              _buffer = &s.buffer;
+              _buffer -> clear();
+            }
+          }
+          
+          explicit operator bool() const { return _buffer != nullptr; }
+          auto operator*() const -> buffer_type& { return *_buffer; }
+          auto operator->() const -> buffer_type* { return _buffer; }
+        };
+      }
+      
+      namespace detail
+      {
+        // compile-time hash of __FILE__ to key the call_site_slot_t.
+        //   it splits the string in halves, then the recursion depth is log2 of the length.
+        constexpr auto hash_source_file ( const char* s, const std::size_t n )
+        -> std::uint64_t
+        {
+          return n == 0
+            ? 14695981039346656037ull
+            : n == 1
+              ? ( 14695981039346656037ull ^ static_cast< std::uint8_t > ( s[ 0 ] ) ) * 1099511628211ull
+              : ( hash_source_file ( s, n / 2 ) * 1099511628211ull ) ^ ( hash_source_file ( s + n / 2, n - n / 2 ) + 0x9e3779b97f4a7c15ull )
+            ;
+        }
+        
+        // run-time hash of the bytes to compare the messages, it reads 8 bytes at a time.
+        inline static auto hash_bytes ( const char* s, std::size_t n, std::uint64_t h = 14695981039346656037ull )
+        -> std::uint64_t
+        {
+          for ( ; n >= 8; s += 8, n -= 8 )
+          {
+            std::uint64_t v;
+            std::memcpy ( &v, s, 8 );
+            h = ( h ^ v ) * 1099511628211ull;
+            h ^= h >> 29;
+          }
+          
+          for ( ; n; ++s, --n )
+            h = ( h ^ static_cast< std::uint8_t > ( *s ) ) * 1099511628211ull;
+          
+          return h ^ ( h >> 32 );
+        }
+      }
+      
+      // per level limits of the LOG macros, each call site keeps the own state of them.
+      //   lines_per_second: the rate of the token bucket, 0 is not limited.
+      //   burst           : the lines passed at once with the full bucket ( 1 or more ).
+      //   sample          : pass 1 in N lines, 0 and 1 pass the all of lines.
+      //   collapse        : the identical consecutive lines of a call site are suppressed,
+      //                     then "last message repeated N times" is written at the next different
+      //                     line or at each collapse times. 0 is not collapsed.
+      struct limit_t
+      {
+        double        lines_per_second = 0;
+        std::uint32_t burst            = 1;
+        std::uint32_t sample           = 1;
+        std::uint32_t collapse         = 0;
+      };
+      
+      // static descriptor of a LOG statement, there is one per __FILE__, __LINE__ and function.
+      //   it is constant-initialized in call_site_slot_t and registered at the first enabled call,
+      //   then the id is the key of the descriptor in the binary format.
+      class call_site_t
+      {
+        std::atomic< std::uint32_t > _id;
+        const char*   _source_file;
+        std::uint32_t _source_line;
+        const char*   _source_function;
+        call_site_t*  _next;
+        
+        // the descriptors of the other functions at the same __FILE__ and __LINE__
+        std::atomic< const char* >   _function_key;
+        std::atomic< call_site_t* >  _siblings;
+        call_site_t*                 _next_sibling;
+        
+        // the state of limit_t, they are initialized statically with the descriptor
+        std::atomic< std::int64_t >  _next_time;
+        std::atomic< std::uint64_t > _sample_count;
+        std::atomic< std::uint64_t > _last_hash;
+        std::atomic< std::uint64_t > _repeats;
+        std::atomic< log::level >    _repeated_level;
+        std::atomic< std::uint64_t > _rate_limited;
+        std::atomic< std::uint64_t > _sampled_out;
+        std::atomic< std::uint64_t > _collapsed;
+        
+        struct registry_t
+        {
+          std::mutex    mutex;
+          call_site_t*  head  = nullptr;
+          std::uint32_t count = 0;
+        };
+        
+        static auto registry()
+        -> registry_t&
+        {
+          static registry_t r;
+          return r;
+        }
+        
+      public:
+        constexpr call_site_t()
+          : _id ( 0 )
+          , _source_file ( "" )
+          , _source_line ( 0 )
+          , _source_function ( "" )
+          , _next ( nullptr )
+          , _function_key ( nullptr )
+          , _siblings ( nullptr )
+          , _next_sibling ( nullptr )
+          , _next_time ( 0 )
+          , _sample_count ( 0 )
+          , _last_hash ( 0 )
+          , _repeats ( 0 )
+          , _repeated_level ( level::none )
+          , _rate_limited ( 0 )
+          , _sampled_out ( 0 )
+          , _collapsed ( 0 )
+        { }
+        
+        call_site_t ( const call_site_t& ) = delete;
+        auto operator= ( const call_site_t& ) -> void = delete;
+        
+        // log_t() calls it, then the registry is constructed before and outlives ~log_t()
+        static auto construct_registry()
+        -> void
+        { registry(); }
+        
+        // the descriptor of the function body keyed on the address of __PRETTY_FUNCTION__,
+        //   then the instantiations of a function template have the own descriptors.
+        //   the first function takes this one, and the others are allocated once and never deleted.
+        auto of_function ( const char* source_function )
+        -> call_site_t&
+        {
+          auto key = _function_key.load ( std::memory_order_acquire );
+          
+          if ( key == source_function )
+            return *this;
+          
+          if ( ! key && _function_key.compare_exchange_strong ( key, source_function, std::memory_order_acq_rel ) )
+            return *this;
+          
+          if ( key == source_function )
+            return *this;
+          
+          const auto find = [ this, source_function ] ( ) -> call_site_t*
+          {
+            for ( auto p = _siblings.load ( std::memory_order_acquire ); p; p = p -> _next_sibling )
+              if ( p -> _function_key.load ( std::memory_order_relaxed ) == source_function )
+                return p;
+            
+            return nullptr;
+          };
+          
+          if ( const auto p = find() )
+            return *p;
+          
+          auto& r = registry();
+          std::lock_guard< std::mutex > l ( r.mutex );
+          
+          if ( const auto p = find() )
+            return *p;
+          
+          const auto p = new call_site_t;
+          p -> _function_key.store ( source_function, std::memory_order_relaxed );
+          p -> _next_sibling = _siblings.load ( std::memory_order_relaxed );
+          _siblings.store ( p, std::memory_order_release );
+          
+          return *p;
+        }
+        
+        // register the descriptor at the first call, then return the id ( 1 origin )
+        auto touch ( const char* source_file, const std::uint32_t source_line, const char* source_function )
+        -> std::uint32_t
+        {
+          auto id = _id.load ( std::memory_order_acquire );
+          
+          if ( id )
+            return id;
+          
+          auto& r = registry();
+          std::lock_guard< std::mutex > l ( r.mutex );
+          
+          id = _id.load ( std::memory_order_relaxed );
+          
+          if ( id )
+            return id;
+          
+          _source_file     = source_file ? source_file : "";
+          _source_line     = source_line;
+          _source_function = source_function ? source_function : "";
+          _next            = r.head;
+          r.head           = this;
+          id               = ++r.count;
+          
+          _id.store ( id, std::memory_order_release );
+          return id;
+        }
+        
+        // 0 if it is not registered yet
+        auto id() const
+        -> std::uint32_t
+        { return _id.load ( std::memory_order_acquire ); }
+        
+        auto source_file() const -> const char* { return _source_file; }
+        auto source_line() const -> std::uint32_t { return _source_line; }
+        auto source_function() const -> const char* { return _source_function; }
+        
+        // token bucket as the generic cell rate algorithm, the bucket is one atomic of the next time.
+        //   interval: the ticks of a token, tolerance: the ticks of ( burst - 1 ) tokens
+        auto take_token ( const std::int64_t now, const std::int64_t interval, const std::int64_t tolerance )
+        -> bool
+        {
+          auto next = _next_time.load ( std::memory_order_relaxed );
+          
+          do
+          {
+            const auto base = std::max ( next, now );
+            
+            if ( base - now > tolerance )
+            {
+              _rate_limited.fetch_add ( 1, std::memory_order_relaxed );
+              return false;
+            }
+            
+            if ( _next_time.compare_exchange_weak ( next, base + interval, std::memory_order_relaxed ) )
+              return true;
+          }
+          while ( true );
+        }
+        
+        // pass 1 in n lines, the first line is passed
+        auto sample ( const std::uint32_t n )
+        -> bool
+        {
+          if ( _sample_count.fetch_add ( 1, std::memory_order_relaxed ) % n == 0 )
+            return true;
+          
+          _sampled_out.fetch_add ( 1, std::memory_order_relaxed );
+          return false;
+        }
+        
+        // false if the line is a repeat of the last line of the call site.
+        //   repeated is set to the count to write "last message repeated N times", 0 is nothing to write.
+        //   the lines of the threads are compared in the order of the calls, then it is not exact
+        //   if the threads write the different lines at the same time.
+        auto collapse ( const std::uint64_t hash, const log::level level, const std::uint32_t times, std::uint64_t& repeated )
+        -> bool
+        {
+          if ( _last_hash.exchange ( hash, std::memory_order_relaxed ) == hash )
+          {
+            _collapsed.fetch_add ( 1, std::memory_order_relaxed );
+            _repeated_level.store ( level, std::memory_order_relaxed );
+            
+            repeated = 0;
+            
+            if ( ( _repeats.fetch_add ( 1, std::memory_order_relaxed ) + 1 ) % times == 0 )
+            {
+              _repeats.fetch_sub ( times, std::memory_order_relaxed );
+              repeated = times;
+            }
+            
+            return false;
+          }
+          
+          repeated = _repeats.exchange ( 0, std::memory_order_relaxed );
+          return true;
+        }
+        
+        // take the repeats not written yet, e.g. at log_t::flush() and the destructor of log_t
+        auto take_repeats ( log::level& level )
+        -> std::uint64_t
+        {
+          level = _repeated_level.load ( std::memory_order_relaxed );
+          return _repeats.exchange ( 0, std::memory_order_relaxed );
+        }
+        
+        // the suppressed lines by limit_t for monitoring
+        auto rate_limited_count() const -> std::uint64_t { return _rate_limited.load ( std::memory_order_relaxed ); }
+        auto sampled_out_count() const -> std::uint64_t { return _sampled_out.load ( std::memory_order_relaxed ); }
+        auto collapsed_count() const -> std::uint64_t { return _collapsed.load ( std::memory_order_relaxed ); }
+        
+        auto suppressed_count() const
+        -> std::uint64_t
+        { return rate_limited_count() + sampled_out_count() + collapsed_count(); }
+        
+        // call f( const call_site_t& ) for each registered call site
+        template < class F >
+        static auto for_each ( F&& f )
+        -> void
+        {
+          auto& r = registry();
+          std::lock_guard< std::mutex > l ( r.mutex );
+          
+          for ( auto p = r.head; p; p = p -> _next )
+            f ( static_cast< const call_site_t& > ( *p ) );
+        }
+      };
+      
+      template < std::uint64_t source_file_hash, std::uint32_t source_line >
+      struct call_site_slot_t
+      {
+        static call_site_t site;
+        
+        static auto of ( const char* source_function )
+        -> call_site_t&
+        { return site.of_function ( source_function ); }
+      };
+      
+      template < std::uint64_t source_file_hash, std::uint32_t source_line >
+      call_site_t call_site_slot_t< source_file_hash, source_line >::site;
+      
+      namespace detail
+      {
+        // type tags of the arguments in the binary mode.
+        //   a value is written as the tag and the raw bytes of the native byte order,
+        //   and a string is the tag, the u32 size and the characters.
+        enum class argument_tag
+          : std::uint8_t
+        {
+          string = 1
+          , character
+          , boolean
+          , i8
+          , i16
+          , i32
+          , i64
+          , u8
+          , u16
+          , u32
+          , u64
+          , f32
+          , f64
+        };
+        
+        template < class T >
+        inline static auto integer_tag ( )
+        -> argument_tag
+        {
+          return std::is_signed< T >::value
+            ? ( sizeof( T ) == 1 ? argument_tag::i8 : sizeof( T ) == 2 ? argument_tag::i16 : sizeof( T ) == 4 ? argument_tag::i32 : argument_tag::i64 )
+            : ( sizeof( T ) == 1 ? argument_tag::u8 : sizeof( T ) == 2 ? argument_tag::u16 : sizeof( T ) == 4 ? argument_tag::u32 : argument_tag::u64 )
+            ;
+        }
+        
+        template < class T >
+        inline static auto encode_raw ( line_buffer_t& b, const argument_tag tag, const T value )
+        -> void
+        {
+          b.append ( static_cast< char > ( tag ) );
+          b.append ( reinterpret_cast< const char* > ( &value ), sizeof( T ) );
+        }
+        
+        // the value with a not default format is formatted by the ostream and written as a string
+        template < class T >
+        inline static auto encode_as_text ( line_buffer_t& b, const T& value )
+        -> void
+        {
+          b.append ( static_cast< char > ( argument_tag::string ) );
+          const auto position = b.size();
+          b.append ( sizeof( std::uint32_t ), '\0' );
+          b.stream() << value;
+          const auto size = static_cast< std::uint32_t > ( b.size() - position - sizeof( std::uint32_t ) );
+          std::memcpy ( b.data() + position, &size, sizeof( size ) );
+        }
+        
+        inline static auto encode_argument ( line_buffer_t& b, const string_view_t& value )
+        -> void
+        {
+          if ( ! b.is_default_format() )
+            return encode_as_text ( b, value );
+          
+          encode_raw ( b, argument_tag::string, static_cast< std::uint32_t > ( value.size() ) );
+          b.append ( value.data(), value.size() );
+        }
+        
+        inline static auto encode_argument ( line_buffer_t& b, const std::string& value )
+        -> void
+        { encode_argument ( b, string_view_t ( value ) ); }
+        
+        inline static auto encode_argument ( line_buffer_t& b, const char* value )
+        -> void
+        {
+          if ( value )
+            encode_argument ( b, string_view_t ( value ) );
+        }
+        
+        template < class T >
+        inline static auto encode_argument ( line_buffer_t& b, const T value )
+        -> typename std::enable_if< std::is_arithmetic< T >::value >::type
+        {
+          if ( ! b.is_default_format() || ( line_buffer_t::is_character< T >::value && ! std::is_same< T, char >::value ) )
+            encode_as_text ( b, value );
+          else if ( std::is_same< T, char >::value )
+            encode_raw ( b, argument_tag::character, static_cast< char > ( value ) );
+          else if ( std::is_same< T, bool >::value )
+            encode_raw ( b, argument_tag::boolean, static_cast< std::uint8_t > ( value ) );
+          else if ( line_buffer_t::is_fast_integer< T >::value )
+            encode_raw ( b, integer_tag< T >(), value );
+          else if ( ! b.is_default_precision() || std::is_same< T, long double >::value )
+            encode_as_text ( b, value );
+          else if ( std::is_same< T, float >::value )
+            encode_raw ( b, argument_tag::f32, static_cast< float > ( value ) );
+          else
+            encode_raw ( b, argument_tag::f64, static_cast< double > ( value ) );
+        }
+        
+        template < class T >
+        inline static auto encode_argument ( line_buffer_t& b, const T& value )
+        -> typename std::enable_if< ! line_buffer_t::is_fast< T >::value >::type
+        { encode_as_text ( b, value ); }
+        
+        // ios_base manipulators change the format only, the others ( e.g. std::endl ) write characters
+        inline static auto encode_argument ( line_buffer_t& b, std::ios_base& ( *manipulator ) ( std::ios_base& ) )
+        -> void
+        { b << manipulator; }
+        
+        inline static auto encode_argument ( line_buffer_t& b, std::ostream& ( *manipulator ) ( std::ostream& ) )
+        -> void
+        { encode_as_text ( b, manipulator ); }
+        
+        template < class T, class U = T >
+        inline static auto decode_value ( line_buffer_t& r, const char*& p, const char* e )
+        -> bool
+        {
+          T value;
+          
+          if ( static_cast< std::size_t > ( e - p ) < sizeof( T ) )
+            return false;
+          
+          std::memcpy ( &value, p, sizeof( T ) );
+          p += sizeof( T );
+          r << static_cast< U > ( value );
+          return true;
+        }
+        
+        // write the text of the encoded arguments into the buffer, it is same as the text mode
+        inline static auto decode_arguments ( line_buffer_t& r, const string_view_t& arguments )
+        -> void
+        {
+          auto       p = arguments.begin();
+          const auto e = arguments.end();
+          
+          while ( p < e )
+          {
+            bool ok = false;
+            
+            switch ( static_cast< argument_tag > ( *p++ ) )
+            {
+              case argument_tag::string:
+              {
+                std::uint32_t n;
+                
+                if ( static_cast< std::size_t > ( e - p ) < sizeof( n ) )
+                  break;
+                
+                std::memcpy ( &n, p, sizeof( n ) );
+                p += sizeof( n );
+                
+                if ( static_cast< std::size_t > ( e - p ) < n )
+                  break;
+                
+                r.append ( p, n );
+                p += n;
+                ok = true;
+                break;
+              }
+              
+              case argument_tag::character: ok = decode_value< char >( r, p, e ); break;
+              case argument_tag::boolean  : ok = decode_value< std::uint8_t, bool >( r, p, e ); break;
+              case argument_tag::i8       : ok = decode_value< std::int8_t , int >( r, p, e ); break;
+              case argument_tag::i16      : ok = decode_value< std::int16_t >( r, p, e ); break;
+              case argument_tag::i32      : ok = decode_value< std::int32_t >( r, p, e ); break;
+              case argument_tag::i64      : ok = decode_value< std::int64_t >( r, p, e ); break;
+              case argument_tag::u8       : ok = decode_value< std::uint8_t , unsigned >( r, p, e ); break;
+              case argument_tag::u16      : ok = decode_value< std::uint16_t >( r, p, e ); break;
+              case argument_tag::u32      : ok = decode_value< std::uint32_t >( r, p, e ); break;
+              case argument_tag::u64      : ok = decode_value< std::uint64_t >( r, p, e ); break;
+              case argument_tag::f32      : ok = decode_value< float >( r, p, e ); break;
+              case argument_tag::f64      : ok = decode_value< double >( r, p, e ); break;
+            }
+            
+            if ( ! ok )
+            {
+              r << "<broken arguments>";
+              return;
+            }
+          }
+        }
+      }
+      
+      // source_file and source_function are expected to be string literals ( __FILE__ and __func__ ),
+      //   and message is a view of the buffer of the log statement,
+      //   then a hook must copy them if it needs them after the call.
+      //   in the binary mode, message holds the encoded arguments and binary is true,
+      //   write_line() decodes them to the text.
+      struct log_line_t
+      {
+        std::chrono::time_point< clock_t > time;
+        log::level    level;
+        const char*   source_file;
+        std::uint32_t source_line;
+        const char*   source_function;
+        string_view_t message;
+        const call_site_t* call_site = nullptr;
+        bool               binary    = false;
+        // the structured fields of kv(), nullptr if the line has no fields
+        const fields_t*    fields    = nullptr;
+      };
+      
+      // settings to render the time of lines,
+      //   system_clock_offset is the offset of clock_t to the system_clock of the process wrote the lines.
+      struct time_context_t
+      {
+        clock_t::time_point      start_time;
+        log::time_appearance     time_appearance;
+        log::time_format         time_format;
+        std::chrono::nanoseconds system_clock_offset;
+      };
+      
+      template < class T = void >
+      auto write_line ( line_buffer_t& r, const log_line_t&, const time_context_t& ) -> void;
+      
+      // an encoder writes a line into the buffer, e.g. write_line, encode_json and encode_logfmt
+      using encoder_type = auto ( * ) ( line_buffer_t&, const log_line_t&, const time_context_t& ) -> void;
+      template < class T = void >
+      auto encode_json ( line_buffer_t& r, const log_line_t&, const time_context_t& ) -> void;
+      template < class T = void >
+      auto encode_logfmt ( line_buffer_t& r, const log_line_t&, const time_context_t& ) -> void;
+      template < class T = void >
+      auto encoder ( encoding ) -> encoder_type;
+      template < class T = void >
+      auto write_line ( line_buffer_t& r, const log_line_t& ) -> void;
+      template < class T = void >
+      auto to_string ( const log_line_t& ) -> std::string;
+      template < class T = void >
+      auto operator<< ( std::ostream& o, const log_line_t& ) -> std::ostream&;
+
+      namespace detail
+      {
+        // the conditional operator of the LOG macros needs void type in both sides
+        struct voidify_t
+        {
+          template < class T >
+          auto operator& ( const T& ) const
+          -> void
+          { }
+        };
+        
+        constexpr std::size_t cache_line_size = 64;
+
+        // bounded lock-free queue ( D. Vyukov's sequence per cell algorithm ).
+        //   it is safe for multiple producers and multiple consumers,
+        //   the async mode uses a single consumer and pops on producers only to drop the oldest.
+        template < typename T >
+        class ring_buffer_t
+        {
+          struct cell_t
+          {
+            std::atomic< std::size_t > sequence;
+            T value;
+          };
+
+          static auto round_up_to_power_of_two ( std::size_t n )
+          -> std::size_t
+          {
+            std::size_t r = 2;
+            while ( r < n )
+              r <<= 1;
+            return r;
+          }
+
+          const std::size_t _mask;
+          const std::unique_ptr< cell_t[] > _cells;
+          char _padding_0[ cache_line_size ];
+          std::atomic< std::size_t > _enqueue_position;
+          char _padding_1[ cache_line_size - sizeof( std::atomic< std::size_t > ) ];
+          std::atomic< std::size_t > _dequeue_position;
+          char _padding_2[ cache_line_size - sizeof( std::atomic< std::size_t > ) ];
+
+        public:
+          explicit ring_buffer_t ( const std::size_t capacity )
+            : _mask ( round_up_to_power_of_two ( capacity ) - 1 )
+            , _cells ( new cell_t[ _mask + 1 ] )
+            , _enqueue_position ( 0 )
+            , _dequeue_position ( 0 )
+          {
+            for ( std::size_t n = 0; n <= _mask; ++n )
+              _cells[ n ].sequence.store ( n, std::memory_order_relaxed );
+          }
+
+          ring_buffer_t ( const ring_buffer_t& ) = delete;
+          auto operator= ( const ring_buffer_t& ) -> void = delete;
+
+          auto capacity() const
+          -> std::size_t
+          { return _mask + 1; }
+
+          // write: a functor to write the value into the claimed cell in place,
+          //   then the cells keep and reuse their own resources.
+          template < typename F >
+          auto try_push ( F&& write )
+          -> bool
+          {
+            auto position = _enqueue_position.load ( std::memory_order_relaxed );
+            cell_t* cell;
+
+            while ( true )
+            {
+              cell = &_cells[ position & _mask ];
+              const auto sequence = cell -> sequence.load ( std::memory_order_acquire );
+              const auto difference = static_cast< std::intptr_t > ( sequence ) - static_cast< std::intptr_t > ( position );
+
+              if ( difference == 0 )
+              {
+                if ( _enqueue_position.compare_exchange_weak ( position, position + 1, std::memory_order_relaxed ) )
+                  break;
+              }
+              else if ( difference < 0 )
+                return false;
+              else
+                position = _enqueue_position.load ( std::memory_order_relaxed );
+            }
+
+            write ( cell -> value );
+            cell -> sequence.store ( position + 1, std::memory_order_release );
+            return true;
+          }
+
+          // read    : a functor to read the value in place before the cell is released
+          // position: the sequential number of the popped value
+          template < typename F >
+          auto try_pop ( F&& read, std::size_t& position )
+          -> bool
+          {
+            position = _dequeue_position.load ( std::memory_order_relaxed );
+            cell_t* cell;
+
+            while ( true )
+            {
+              cell = &_cells[ position & _mask ];
+              const auto sequence = cell -> sequence.load ( std::memory_order_acquire );
+              const auto difference = static_cast< std::intptr_t > ( sequence ) - static_cast< std::intptr_t > ( position + 1 );
+
+              if ( difference == 0 )
+              {
+                if ( _dequeue_position.compare_exchange_weak ( position, position + 1, std::memory_order_relaxed ) )
+                  break;
+              }
+              else if ( difference < 0 )
+                return false;
+              else
+                position = _dequeue_position.load ( std::memory_order_relaxed );
+            }
+
+            read ( cell -> value );
+            cell -> sequence.store ( position + _mask + 1, std::memory_order_release );
+            return true;
+          }
+
+          auto enqueue_position() const
+          -> std::size_t
+          { return _enqueue_position.load ( std::memory_order_acquire ); }
+
+          auto dequeue_position() const
+          -> std::size_t
+          { return _dequeue_position.load ( std::memory_order_acquire ); }
+        };
+
+        // epoch based reclamation for the settings read by the logging path.
+        //   a reader enters a section without any lock, and a writer publishes a new object,
+        //   advances the epoch then waits until the readers of the old epoch exit the section
+        //   before deleting the old object.
+        //   the reader counters are striped per thread to avoid to share a cache line.
+        class epoch_t
+        {
+          static constexpr std::size_t stripes = 16;
+          
+          struct counter_t
+          {
+            std::atomic< std::int64_t > count;
+            char _padding[ cache_line_size - sizeof( std::atomic< std::int64_t > ) ];
+          };
+          
+          std::atomic< std::uint64_t > _epoch;
+          char _padding[ cache_line_size - sizeof( std::atomic< std::uint64_t > ) ];
+          std::array< std::array< counter_t, stripes >, 2 > _readers;
+          
+          static auto stripe()
+          -> std::size_t
+          {
+            static std::atomic< std::size_t > next ( 0 );
+            thread_local const auto s = next.fetch_add ( 1, std::memory_order_relaxed ) % stripes;
+            return s;
+          }
+          
+          static auto depth()
+          -> std::size_t&
+          {
+            thread_local std::size_t d = 0;
+            return d;
+          }
+          
+        public:
+          class guard_t
+          {
+            epoch_t*      _master;
+            counter_t*    _counter;
+            
+          public:
+            explicit guard_t ( epoch_t& master )
+              : _master ( &master )
+            {
+              const auto s = stripe();
+              
+              for ( ; ; )
+              {
+                const auto e = master._epoch.load ( std::memory_order_seq_cst );
+                _counter = &master._readers[ e & 1 ][ s ];
+                _counter -> count.fetch_add ( 1, std::memory_order_seq_cst );
+                
+                if ( master._epoch.load ( std::memory_order_seq_cst ) == e )
+                  break;
+                
+                _counter -> count.fetch_sub ( 1, std::memory_order_release );
+              }
+              
+              ++depth();
+            }
+            
+            guard_t ( guard_t&& g )
+              : _master ( g._master )
+              , _counter ( g._counter )
+            { g._master = nullptr; }
+            
+            guard_t ( const guard_t& ) = delete;
+            auto operator= ( const guard_t& ) -> void = delete;
+            
+            ~guard_t()
+            {
+              if ( ! _master )
+                return;
+              
+              --depth();
+              _counter -> count.fetch_sub ( 1, std::memory_order_release );
+            }
+          };
+          
+          epoch_t()
+            : _epoch ( 0 )
+          {
+            for ( auto& rs : _readers )
+              for ( auto& r : rs )
+                r.count.store ( 0, std::memory_order_relaxed );
+          }
+          
+          auto read()
+          -> guard_t
+          { return guard_t ( *this ); }
+          
+          // true if the thread is in a reader section, then it must not call synchronize()
+          static auto in_reader()
+          -> bool
+          { return depth() != 0; }
+          
+          // wait until the all of readers entered before the call exit, the writers must be serialized
+          auto synchronize()
+          -> void
+          {
+            if ( in_reader() )
+              throw std::logic_error ( "wonderland.log: epoch_t::synchronize is called in a reader section" );
+            
+            const auto e = _epoch.fetch_add ( 1, std::memory_order_seq_cst );
+            auto& rs = _readers[ e & 1 ];
+            
+            const auto drained = [ & ]
+            {
+              std::int64_t n = 0;
+              
+              for ( const auto& r : rs )
+                n += r.count.load ( std::memory_order_acquire );
+              
+              return n == 0;
+            };
+            
+            while ( ! drained() )
+              std::this_thread::yield();
+          }
+        };
+        
+        // the buffered outputs ( e.g. file_sink_t ) register the flush functions with a key,
+        //   then log_t::flush(), ~log_t() and the if_fatal exit paths call them
+        //   and std::quick_exit from anywhere calls them too.
+        class flush_registry_t
+        {
+          std::mutex _mutex;
+          std::vector< std::pair< const void*, std::function< auto ( ) -> void > > > _entries;
+          
+          flush_registry_t()
+          {
+#if ! defined( EMSCRIPTEN ) && ! defined( __MINGW32__ )
+            std::at_quick_exit ( [ ] { flush_registry_t::instance().flush(); } );
+#endif
+          }
+          
+        public:
+          static auto instance()
+          -> flush_registry_t&
+          {
+            static flush_registry_t r;
+            return r;
+          }
+          
+          auto add ( const void* key, std::function< auto ( ) -> void > f )
+          -> void
+          {
+            std::lock_guard< std::mutex > l ( _mutex );
+            _entries.emplace_back ( key, std::move ( f ) );
+          }
+          
+          auto remove ( const void* key )
+          -> void
+          {
+            std::lock_guard< std::mutex > l ( _mutex );
+            _entries.erase
+            ( std::remove_if
+              ( _entries.begin(), _entries.end()
+                , [ key ] ( const decltype( _entries )::value_type& e ) { return e.first == key; }
+              )
+              , _entries.end()
+            );
+          }
+          
+          // the exceptions of the flush functions are ignored, it may be called on the exit paths
+          auto flush()
+          -> void
+          {
+            std::lock_guard< std::mutex > l ( _mutex );
+            
+            for ( const auto& e : _entries )
+              try
+              {
+                e.second();
+              }
+              catch ( ... )
+              { }
+          }
+        };
+        
+        // background writer of the async mode.
+        //   producers push finished lines, the writer thread drains them in batches
+        //   and calls the consumer ( log_t dispatches the lines to the hooks ).
+        class async_dispatcher_t
+        {
+        public:
+          using consumer_type = std::function < auto ( log_line_t& ) -> void >;
+
+          static constexpr std::size_t batch_size = 256;
+
+        private:
+          // the message of a pushed line is copied into the cell,
+          //   and the capacity of the string is reused by the next round.
+          struct async_line_t
+          {
+            log_line_t  line;
+            std::string message;
+            fields_t    fields;
+          };
+
+          ring_buffer_t< async_line_t > _ring;
+          const overflow_policy _policy;
+          const consumer_type   _consumer;
+
+          // all of lines before the position are written or dropped
+          std::atomic< std::size_t >   _completed_position;
+          std::atomic< std::uint64_t > _dropped;
+          std::atomic< std::size_t >   _flush_waiters;
+          std::atomic< bool >          _sleeping;
+          std::atomic< bool >          _stop;
+
+          std::mutex              _mutex;
+          std::condition_variable _wake;
+          std::condition_variable _flushed;
+
+          std::thread _thread;
+
+          // a missed wake up is recovered by the timeout of the writer's wait
+          auto wake()
+          -> void
+          {
+            if ( _sleeping.load ( std::memory_order_seq_cst ) )
+            {
+              std::lock_guard< std::mutex > l ( _mutex );
+              _wake.notify_one();
+            }
+          }
+
+          auto notify_flushed()
+          -> void
+          {
+            if ( _flush_waiters.load ( std::memory_order_acquire ) )
+            {
+              std::lock_guard< std::mutex > l ( _mutex );
+              _flushed.notify_all();
+            }
+          }
+
+          auto run()
+          -> void
+          {
+            const auto consume = [ this ] ( async_line_t& a ) { _consumer ( a.line ); };
+            std::size_t position;
+
+            while ( true )
+            {
+              std::size_t n = 0;
+
+              while ( n < batch_size && _ring.try_pop ( consume, position ) )
+              {
+                _completed_position.store ( position + 1, std::memory_order_release );
+                ++n;
+              }
+
+              if ( n )
+              {
+                notify_flushed();
+                continue;
+              }
+
+              // empty, or the next line is just being written by a producer.
+              //   the lines dropped by producers are also completed.
+              _completed_position.store ( _ring.dequeue_position(), std::memory_order_release );
+              notify_flushed();
+
+              if ( _stop.load ( std::memory_order_acquire ) && _ring.enqueue_position() == _ring.dequeue_position() )
+                break;
+
+              std::unique_lock< std::mutex > l ( _mutex );
+              _sleeping.store ( true, std::memory_order_seq_cst );
+
+              if ( _ring.enqueue_position() == _ring.dequeue_position() && ! _stop.load ( std::memory_order_acquire ) )
+                _wake.wait_for ( l, std::chrono::milliseconds ( 10 ) );
+
+              _sleeping.store ( false, std::memory_order_relaxed );
+            }
+          }
+
+        public:
+          async_dispatcher_t
+          ( const std::size_t     capacity
+            , const overflow_policy policy
+            , consumer_type&&       consumer
+          )
+            : _ring ( capacity )
+            , _policy ( policy )
+            , _consumer ( std::move ( consumer ) )
+            , _completed_position ( 0 )
+            , _dropped ( 0 )
+            , _flush_waiters ( 0 )
+            , _sleeping ( false )
+            , _stop ( false )
+            , _thread ( [ this ] { run(); } )
+          { }
+
+          async_dispatcher_t ( const async_dispatcher_t& ) = delete;
+          auto operator= ( const async_dispatcher_t& ) -> void = delete;
+
+          // the writer thread must not delete its own dispatcher, it returns to run() after.
+          //   log_t does not delete it in a reader section, and the writer is always in it.
+          ~async_dispatcher_t()
+          { stop(); }
+
+          auto push ( const log_line_t& line )
+          -> void
+          {
+            const auto write = [ &line ] ( async_line_t& a )
+            {
+              a.message.assign ( line.message.data(), line.message.size() );
+              a.line = line;
+              a.line.message = a.message;
+              
+              if ( line.fields )
+              {
+                a.fields      = *line.fields;
+                a.line.fields = &a.fields;
+              }
+            };
+
+            while ( ! _ring.try_push ( write ) )
+              switch ( _policy )
+              {
+                case overflow_policy::drop_newest:
+                  _dropped.fetch_add ( 1, std::memory_order_relaxed );
+                  return;
+
+                case overflow_policy::drop_oldest:
+                {
+                  std::size_t position;
+
+                  if ( _ring.try_pop ( [ ] ( async_line_t& ) { }, position ) )
+                    _dropped.fetch_add ( 1, std::memory_order_relaxed );
+
+                  break;
+                }
+
+                case overflow_policy::block:
+                  wake();
+                  std::this_thread::yield();
+                  break;
+              }
+
+            wake();
+          }
+
+          // write all of the pushed lines and stop the writer thread.
+          //   on the writer thread ( e.g. a hook calls std::exit ) the rest of lines are written
+          //   in place and the thread is not joined, it does not return from the exit.
+          auto stop()
+          -> void
+          {
+            if ( is_writer_thread() )
+            {
+              const auto consume = [ this ] ( async_line_t& a ) { _consumer ( a.line ); };
+              std::size_t position;
+
+              while ( _ring.try_pop ( consume, position ) )
+                _completed_position.store ( position + 1, std::memory_order_release );
+
+              return;
+            }
+
+            _stop.store ( true, std::memory_order_release );
+
+            {
+              std::lock_guard< std::mutex > l ( _mutex );
+              _wake.notify_one();
+            }
+
+            if ( _thread.joinable() )
+              _thread.join();
+          }
+
+          // wait until the all of lines pushed before the call are written or dropped
+          auto flush()
+          -> void
+          {
+            if ( is_writer_thread() )
+              return;
+
+            const auto target = _ring.enqueue_position();
+
+            _flush_waiters.fetch_add ( 1, std::memory_order_acq_rel );
+
+            {
+              std::lock_guard< std::mutex > l ( _mutex );
+              _wake.notify_one();
+            }
+
+            {
+              std::unique_lock< std::mutex > l ( _mutex );
+
+              while ( _completed_position.load ( std::memory_order_acquire ) < target )
+                _flushed.wait_for ( l, std::chrono::milliseconds ( 1 ) );
+            }
+
+            _flush_waiters.fetch_sub ( 1, std::memory_order_acq_rel );
+          }
+
+          auto dropped_count() const
+          -> std::uint64_t
+          { return _dropped.load ( std::memory_order_relaxed ); }
+
+          auto capacity() const
+          -> std::size_t
+          { return _ring.capacity(); }
+
+          auto policy() const
+          -> overflow_policy
+          { return _policy; }
+
+          auto is_writer_thread() const
+          -> bool
+          { return std::this_thread::get_id() == _thread.get_id(); }
+        };
+      }
+
+      class log_t final
+      {
+        friend class  log_stream_t;
+        friend struct log_line_t;
+        
+      public:
+        using hook_type          = std::function < auto ( log_line_t& ) -> void >;
+        using hooks_type         = std::vector< hook_type >;
+        using destruct_hook_type = std::function < auto ( ) -> void >;
+        
+        class log_stream_t
+        {
+          log_t& _master;
+          const level         _level;
+          const char* const   _source_file;
+          const std::uint32_t _source_line;
+          const char* const   _source_function;
+          const call_site_t*  _call_site;
+          const bool          _binary;
+          detail::thread_buffer_t< detail::message_buffer_tag > _buffer;
+          detail::thread_buffer_t< detail::fields_buffer_tag, fields_t > _fields;
+          
+          template < class T >
+          auto write ( const T& value )
+          -> log_stream_t&
+          {
+            if ( ! _buffer )
+              ;
+            else if ( _binary )
+              detail::encode_argument ( *_buffer, value );
+            else
+              ( *_buffer ) << value;
+            
+            return *this;
+          }
+          
+          // the hash of the message and the fields to collapse the repeated lines
+          auto hash() const
+          -> std::uint64_t
+          {
+            auto h = detail::hash_bytes ( _buffer -> data(), _buffer -> size() );
+            
+            if ( _fields )
+              for ( std::size_t n = 0; n < _fields -> size(); ++n )
+              {
+                const auto f = ( *_fields )[ n ];
+                h = detail::hash_bytes ( f.key.data(), f.key.size(), h ^ static_cast< std::uint64_t > ( f.type ) );
+                
+                std::uint64_t bits = 0;
+                
+                switch ( f.type )
+                {
+                  case field_type::string:
+                    h = detail::hash_bytes ( f.string.data(), f.string.size(), h );
+                    continue;
+                  
+                  case field_type::boolean: bits = f.boolean; break;
+                  case field_type::i64:     std::memcpy ( &bits, &f.i64, sizeof( bits ) ); break;
+                  case field_type::u64:     bits = f.u64; break;
+                  case field_type::f64:     std::memcpy ( &bits, &f.f64, sizeof( bits ) ); break;
+                }
+                
+                h = detail::hash_bytes ( reinterpret_cast< const char* > ( &bits ), sizeof( bits ), h );
+              }
+            
+            return h;
+          }
+          
+        public:
+          template<class T>
+          auto operator<< ( const T& value )
+          -> log_stream_t&
+          { return write ( value ); }
+          
+          auto operator<< ( std::ios_base& ( *manipulator ) ( std::ios_base& ) )
+          -> log_stream_t&
+          { return write ( manipulator ); }
+          
+          auto operator<< ( std::ostream& ( *manipulator ) ( std::ostream& ) )
+          -> log_stream_t&
+          { return write ( manipulator ); }
+          
+          // add a typed field, e.g. LOGI.kv( "user", id ).kv( "latency_us", t ) << "request done"
+          template < class T >
+          auto kv ( const string_view_t& key, const T& value )
+          -> log_stream_t&
+          {
+            if ( _buffer )
+            {
+              _fields.acquire();
+              _fields -> add ( key, value );
+            }
+            
+            return *this;
+          }
+          
+          // the message is formatted into the per-thread reusable buffer,
+          //   or the arguments are encoded into it without formatting if binary is true.
+          //   enabled: false then the buffer is not acquired and ignores the all of values
+          explicit log_stream_t
+          ( log_t&              master
+            , const level         level
+            , const char*         source_file
+            , const std::uint32_t source_line
+            , const char*         source_function
+            , const bool          enabled   = true
+            , const call_site_t*  call_site = nullptr
+            , const bool          binary    = false
+          )
+            : _master ( master )
+            , _level ( level )
+            , _source_file ( source_file ? source_file : "" )
+            , _source_line ( source_line )
+            , _source_function ( source_function ? source_function : "" )
+            , _call_site ( call_site )
+            , _binary ( binary )
+            , _buffer ( enabled )
+            , _fields ( false )
+          { }
+          
+          log_stream_t ( log_stream_t&& ) = default;
+          
+          ~log_stream_t()
+          {
+            if ( ! _buffer )
+              return;
+            
+            try
+            {
+              const auto collapse = _call_site ? _master.collapse_times ( _level ) : 0;
+              
+              if ( collapse )
+              {
+                std::uint64_t repeated = 0;
+                
+                const auto passed = const_cast< call_site_t* > ( _call_site ) -> collapse ( hash(), _level, collapse, repeated );
+                
+                if ( repeated )
+                  _master.append_repeated ( _level, *_call_site, repeated );
+                
+                if ( ! passed )
+                  return;
+              }
+              
+              _master.append
+              ( { clock_t::now()
+                  , _level
+                  , _source_file
+                  , _source_line
+                  , _source_function
+                  , _buffer -> view()
+                  , _call_site
+                  , _binary
+                  , _fields ? &*_fields : nullptr
+                }
+              );
+            }
+            catch ( const std::exception& e )
+            {
+              std::cerr
+                  << "[WARNING] occurred exception, but here is a destructor of log_stream_t class."
+                  " then the exception reserve the next log_t any function call timing.\n"
+                  "  exception type name: " << typeid ( e ).name() << "\n"
+                  "  exception what     : " << e.what() << "\n"
+                  ;
+              _master.reserve_exception ( e.what() );
+            }
+            catch ( ... )
+            {
+              std::cerr
+                  << "[WARNING] occurred exception, but here is a destructor of log_stream_t class."
+                  " then the exception reserve the next log_t any function call timing.\n"
+                  "  exception type name: ... \n"
+                  "  exception what     : \n"
+                  ;
+              _master.reserve_exception ( "..." );
+            }
+          }
+        };
+        
+      private:
+      
+        std::atomic< level > _default_level;
+        std::atomic< level > _keep_level;
+        std::atomic< bool >  _binary_mode;
+        
+        // limit_t of each level for the admission of the LOG macros.
+        //   _limited_levels is the bit set of the levels with any limit, and _limits keeps the settings.
+        struct limit_state_t
+        {
+          std::atomic< std::int64_t >  interval;
+          std::atomic< std::int64_t >  tolerance;
+          std::atomic< std::uint32_t > sample;
+          std::atomic< std::uint32_t > collapse;
+        };
+        
+        std::atomic< std::uint32_t >     _limited_levels;
+        std::array< limit_state_t, 6 >   _limit_states;
+        std::array< limit_t, 6 >         _limits;
+        
+        // the logging path reads the hooks and the async writer in a reader section of _epoch,
+        //   and the setters publish new objects then delete the old ones after the readers exit.
+        std::atomic< const hooks_type* >              _hooks;
+        std::atomic< detail::async_dispatcher_t* >    _async;
+        mutable detail::epoch_t                       _epoch;
+        mutable std::mutex                            _configure_mutex;
+        
+        destruct_hook_type _at_destruct_hook;
+        
+        const clock_t::time_point _start_time;
+        std::atomic< log::time_appearance > _time_appearance;
+        std::atomic< log::time_format >     _time_format;
+        
+        std::atomic< log::if_fatal > _if_fatal;
+        
+        std::atomic< bool > _has_exception;
+        mutable std::mutex  _exception_mutex;
+#ifndef EMSCRIPTEN
+        std::exception_ptr _exception_ptr;
+#else
+        std::unique_ptr< fatal_exception > _pseudo_exception_ptr;
+#endif
+        
+        // the login line is written once before the first line
+        std::once_flag      _login_once;
+        std::atomic< bool > _logged_in;
+        
+        log_t( )
+          : _default_level ( level::info )
+          , _keep_level ( level::debug )
+          , _binary_mode ( false )
+          , _limited_levels ( 0 )
+          , _hooks
+            ( new hooks_type
+              {
+                [ ] ( log_line_t& log_line )
+                {
+                  std::lock_guard<std::mutex> l ( write_mutex );
+                  std::cerr << log_line;
+                }
+              }
+            )
+          , _async ( nullptr )
+          , _at_destruct_hook ( [ ]( ) { } )
+          , _start_time ( clock_t::now() )
+          , _time_appearance ( log::time_appearance::f64_in_seconds_from_run )
+          , _time_format ( log::time_format::gmt )
+          , _if_fatal ( log::if_fatal::none )
+          , _has_exception ( false )
+#ifndef EMSCRIPTEN
+          , _exception_ptr ( nullptr )
+#else
+          , _pseudo_exception_ptr ( nullptr )
+#endif
+          , _logged_in ( false )
+        {
+          // construct the registries before the instance, then they outlive ~log_t()
+          detail::flush_registry_t::instance();
+          call_site_t::construct_registry();
+          
+          for ( auto& state : _limit_states )
+          {
+            state.interval.store ( 0, std::memory_order_relaxed );
+            state.tolerance.store ( 0, std::memory_order_relaxed );
+            state.sample.store ( 1, std::memory_order_relaxed );
+            state.collapse.store ( 0, std::memory_order_relaxed );
+          }
+        }
+        
+        log_t ( const log_t& ) = delete;
+        log_t ( log_t&& ) = delete;
+        
+        auto operator= ( const log_t& ) -> void = delete;
+        auto operator= ( log_t&& ) -> void = delete;
+        
+        // replace the object and delete the old one after the readers of it exit,
+        //   the setters are serialized with _configure_mutex.
+        //   the old one is deleted out of the mutex, then ~async_dispatcher_t() can wait
+        //   the hooks of the writer thread those use the getters with the mutex.
+        template < class T >
+        auto publish ( std::atomic< T* >& target, T* value )
+        -> void
+        {
+          std::unique_ptr< T > p ( value );
+          
+          if ( detail::epoch_t::in_reader() )
+            throw std::logic_error ( "wonderland.log: the settings of log_t cannot be changed in a hook" );
+          
+          std::unique_ptr< T > old;
+          
+          {
+            std::lock_guard< std::mutex > l ( _configure_mutex );
+            old.reset ( target.exchange ( p.release(), std::memory_order_acq_rel ) );
+            _epoch.synchronize();
+          }
+        }
+        
+        // stop the async writer in ~log_t() without throwing. in a reader section ( e.g. std::exit
+        //   by if_fatal::exit in a hook ) it cannot wait the readers, then the writer is stopped
+        //   and the old object is left to the end of the process.
+        auto stop_async()
+        -> void
+        {
+          if ( ! detail::epoch_t::in_reader() )
+            try
+            {
+              publish ( _async, static_cast< detail::async_dispatcher_t* > ( nullptr ) );
+              return;
+            }
+            catch ( ... )
+            { }
+          
+          if ( const auto async = _async.exchange ( nullptr, std::memory_order_acq_rel ) )
+            async -> stop();
+        }
+        
+        auto append ( log_line_t&& line )
+        -> void
+        {
+          rethrow();
+          
+          // a hook logs in the login line then it is written without waiting the once_flag
+          thread_local bool in_login = false;
+          
+          if ( ! _logged_in.load ( std::memory_order_acquire ) && ! in_login )
+            std::call_once
+            ( _login_once
+              , [ this ]
+              {
+                const auto login_message
+                  = std::string ( "login time: " ) + detail::to_string_iso8601 ( _start_time, time_format() );
+                
+                in_login = true;
+                
+                try
+                {
+                  append_line ( { _start_time, level::info, "", 0, "", login_message } );
+                }
+                catch ( ... )
+                {
+                  in_login = false;
+                  throw;
+                }
+                
+                in_login = false;
+                _logged_in.store ( true, std::memory_order_release );
+              }
+            );
+          
+          append_line ( std::move ( line ) );
+        }
+        
+        auto append_line ( log_line_t&& line )
+        -> void
+        {
+          if ( is_enabled ( line.level ) )
+          {
+            const auto guard = _epoch.read();
+            const auto async = _async.load ( std::memory_order_acquire );
+            
+            if ( async && ! async -> is_writer_thread() )
+              async -> push ( line );
+            else
+              dispatch ( line );
+          }
+          
+          if ( line.level == level::fatal )
+          {
+            // drain the async writer before exit or throw, then no lines are lost
+            flush();
+            
+            std::cerr << "[WARNING] detect a `fatal` level log and the if_fatal flag is ";
+            
+            switch ( _if_fatal.load ( std::memory_order_relaxed ) )
+            {
+              case log::if_fatal::none:
+                std::cerr << " `if_fatal::none` then nothing to do.\n";
+                break;
+                
+              case log::if_fatal::exit:
+                std::cerr << " `if_fatal::exit` then call std::exit( EXIT_FAILURE ) now.\n";
+                std::exit ( EXIT_FAILURE );
+                
+              case log::if_fatal::quick_exit:
+                std::cerr << " `if_fatal::quick_exit` then call std::quick_exit( EXIT_FAILURE ) now.\n";
+#if defined( EMSCRIPTEN ) || defined( __MINGW32__ )
+                std::cerr
+                    << "[WARNING] Emscripten or MINGW is not support std::quick_exit yet,"
+                    " then call std::exit alternatively.\n"
+                    ;
+                std::exit ( EXIT_FAILURE );
+#else
+                std::quick_exit ( EXIT_FAILURE );
+#endif
+                
+              case log::if_fatal::exception:
+                std::cerr << " `if_fatal::exception` then throw fatal_exception now.\n";
+                throw fatal_exception ( to_string ( line ) );
+            }
+          }
+        }
+        
+        // write "last message repeated N times" of the collapsed lines of the call site
+        auto append_repeated ( const level level, const call_site_t& call_site, const std::uint64_t repeated )
+        -> void
+        {
+          char message[ 64 ];
+          const auto size = std::snprintf
+          ( message, sizeof( message ), "last message repeated %llu times", static_cast< unsigned long long > ( repeated ) );
+          
+          append
+          ( { clock_t::now()
+              , level
+              , call_site.source_file()
+              , call_site.source_line()
+              , call_site.source_function()
+              , string_view_t ( message, static_cast< std::size_t > ( size ) )
+              , &call_site
+            }
+          );
+        }
+        
+        // write the repeats of the all of call sites which are not written yet.
+        //   the call sites are collected before the lines, then a hook can log at a new call site.
+        auto append_pending_repeats()
+        -> void
+        {
+          struct pending_t
+          {
+            call_site_t*  call_site;
+            log::level    line_level;
+            std::uint64_t repeated;
+          };
+          
+          std::vector< pending_t > pendings;
+          
+          call_site_t::for_each
+          ( [ &pendings ] ( const call_site_t& s )
+            {
+              log::level level;
+              const auto repeated = const_cast< call_site_t& > ( s ).take_repeats ( level );
+              
+              if ( repeated )
+                pendings.push_back ( { &const_cast< call_site_t& > ( s ), level, repeated } );
+            }
+          );
+          
+          for ( const auto& p : pendings )
+            append_repeated ( p.line_level, *p.call_site, p.repeated );
+        }
+        
+        // the collapse times of the level, 0 if the repeated lines are not collapsed
+        auto collapse_times ( const level level ) const
+        -> std::uint32_t
+        { return _limit_states[ std::uint8_t ( level ) ].collapse.load ( std::memory_order_relaxed ); }
+        
+        // call it in a reader section of _epoch
+        auto dispatch ( log_line_t& line )
+        -> void
+        {
+          const auto hooks = _hooks.load ( std::memory_order_acquire );
+          
+          if ( hooks )
+            for ( const auto& hook : *hooks )
+              hook ( line );
+        }
+        
+        // consumer of the async writer thread, exceptions are reserved as like as log_stream_t
+        auto dispatch_async ( log_line_t& line )
+        -> void
+        {
+          try
+          {
+            const auto guard = _epoch.read();
+            dispatch ( line );
+          }
+          catch ( const std::exception& e )
+          {
+            std::cerr
+                << "[WARNING] occurred exception, but here is the async writer thread of log_t class."
+                " then the exception reserve the next log_t any function call timing.\n"
+                "  exception type name: " << typeid ( e ).name() << "\n"
+                "  exception what     : " << e.what() << "\n"
+                ;
+            reserve_exception ( e.what() );
+          }
+          catch ( ... )
+          {
+            std::cerr
+                << "[WARNING] occurred exception, but here is the async writer thread of log_t class."
+                " then the exception reserve the next log_t any function call timing.\n"
+                "  exception type name: ... \n"
+                "  exception what     : \n"
+                ;
+            reserve_exception ( "..." );
+          }
+        }
+        
+        // call it in a catch block, the exception is rethrown at the next call of log_t
+        auto reserve_exception ( const char* what )
+        -> void
+        {
+          std::lock_guard< std::mutex > l ( _exception_mutex );
+#ifndef EMSCRIPTEN
+          ( void ) what;
+          _exception_ptr = std::current_exception();
+#else
+          _pseudo_exception_ptr.reset ( new fatal_exception ( what ) );
+#endif
+          _has_exception.store ( true, std::memory_order_release );
+        }
+        
+        auto rethrow() const
+        -> void
+        {
+          if ( ! _has_exception.load ( std::memory_order_acquire ) )
+            return;
+          
+#ifndef EMSCRIPTEN
+          std::exception_ptr e;
+          
+          {
+            std::lock_guard< std::mutex > l ( _exception_mutex );
+            e = _exception_ptr;
+          }
+          
+          if ( e != nullptr )
+            std::rethrow_exception ( e );
             
 #else
+          std::lock_guard< std::mutex > l ( _exception_mutex );
             
           if ( _pseudo_exception_ptr )
           {
@@ -513,18 +2789,16 @@ namespace wonder_rabbit_project
         
         ~log_t( )
         {
-#ifndef EMSCRIPTEN
-        
-          if ( _exception_ptr != nullptr )
-#else
-          if ( _pseudo_exception_ptr )
-#endif
+          if ( _has_exception.load ( std::memory_order_acquire ) )
           {
             std::cerr
                 << "[WARNING] log_t has reserved exception, but here is destructor of log_t class."
                 " then show the exception detail if exception based on std::exception,"
                 " and std::quick_exit( EXIT_FAILURE ) now.\n  "
                 ;
+            
+            stop_async();
+            detail::flush_registry_t::instance().flush();
 #ifndef EMSCRIPTEN
                 
             try
@@ -554,148 +2828,441 @@ namespace wonder_rabbit_project
 #endif
           }
           
+          // drain the async writer before, then the logout line is the last line
+          //   even if this is the writer thread
+          stop_async();
+          
+          try
+          {
+            append_pending_repeats();
+          }
+          catch ( ... )
+          { }
+          
           ( *this ) ( level::info )
               << "logout time: "
-              << detail::to_string_iso8601 ( clock_t::now(), _time_format )
+              << detail::to_string_iso8601 ( clock_t::now(), time_format() )
               ;
-          _at_destruct_hook( );
+          
+          // call the hook out of the lock, then it can change the settings
+          destruct_hook_type at_destruct_hook;
+          
+          {
+            std::lock_guard< std::mutex > l ( _configure_mutex );
+            at_destruct_hook = _at_destruct_hook;
+          }
+          
+          if ( at_destruct_hook )
+            at_destruct_hook( );
+          
+          // the destruct hook can enable the async mode again
+          stop_async();
+          detail::flush_registry_t::instance().flush();
+          
+          // the hooks of a reader section are left to the end of the process as like as the writer
+          if ( ! detail::epoch_t::in_reader() )
+            try
+            {
+              publish ( _hooks, static_cast< const hooks_type* > ( nullptr ) );
+            }
+            catch ( ... )
+            { }
         }
         
+        // source_file and source_function must outlive the line ( e.g. string literals )
         auto operator()
-        ( std::string&& source_file     = ""
-                                          , uint32_t      source_line     = 0
-                                              , std::string && source_function = ""
+        ( const char*     source_file     = ""
+          , std::uint32_t source_line     = 0
+          , const char*   source_function = ""
         )
         -> log_stream_t
-        { return ( *this ) ( _default_level, std::move ( source_file ), source_line, std::move ( source_function ) ); }
+        { return ( *this ) ( default_level(), source_file, source_line, source_function ); }
         
         auto operator()
         ( level level
-          , std::string&& source_file     = ""
-                                            , uint32_t      source_line     = 0
-                                                , std::string && source_function = ""
+          , const char*   source_file     = ""
+          , std::uint32_t source_line     = 0
+          , const char*   source_function = ""
+        )
+        -> log_stream_t
+        {
+          rethrow();
+          return log_stream_t ( *this, level, source_file, source_line, source_function, is_enabled ( level ) );
+        }
+        
+        // the LOG macros use it with the static descriptor of the statement
+        auto operator()
+        ( call_site_t&    call_site
+          , const char*   source_file
+          , std::uint32_t source_line
+          , const char*   source_function
+        )
+        -> log_stream_t
+        { return ( *this ) ( call_site, default_level(), source_file, source_line, source_function ); }
+        
+        auto operator()
+        ( call_site_t&    call_site
+          , level         level
+          , const char*   source_file
+          , std::uint32_t source_line
+          , const char*   source_function
         )
         -> log_stream_t
         {
           rethrow();
-          return log_stream_t ( *this, level, std::move ( source_file ), source_line, std::move ( source_function ) );
+          
+          if ( ! is_enabled ( level ) )
+            return log_stream_t ( *this, level, source_file, source_line, source_function, false );
+          
+          call_site.touch ( source_file, source_line, source_function );
+          
+          return log_stream_t
+          ( *this, level, source_file, source_line, source_function
+            , true
+            , &call_site
+            , _binary_mode.load ( std::memory_order_relaxed )
+          );
+        }
+        
+        // the admission of the LOG macros by the limits of the level, it is checked after is_enabled.
+        //   it costs a load if the level is not limited, and a few atomic operations of the call site
+        //   if it is limited. the collapse of the repeated lines is checked at the end of the statement.
+        auto admit
+        ( call_site_t&    call_site
+          , level         level
+          , const char*   source_file
+          , std::uint32_t source_line
+          , const char*   source_function
+        )
+        -> bool
+        {
+          const auto index = std::uint8_t ( level );
+          
+          if ( ! ( ( _limited_levels.load ( std::memory_order_relaxed ) >> index ) & 1u ) )
+            return true;
+          
+          // register the call site, then the suppressed lines are found by call_site_t::for_each
+          call_site.touch ( source_file, source_line, source_function );
+          
+          const auto& state  = _limit_states[ index ];
+          const auto  sample = state.sample.load ( std::memory_order_relaxed );
+          
+          if ( sample > 1 && ! call_site.sample ( sample ) )
+            return false;
+          
+          const auto interval = state.interval.load ( std::memory_order_relaxed );
+          
+          return interval == 0
+              || call_site.take_token
+                 ( static_cast< std::int64_t > ( clock_t::now().time_since_epoch().count() )
+                   , interval
+                   , state.tolerance.load ( std::memory_order_relaxed )
+                 )
+              ;
         }
         
+        auto admit
+        ( call_site_t&    call_site
+          , const char*   source_file
+          , std::uint32_t source_line
+          , const char*   source_function
+        )
+        -> bool
+        { return admit ( call_site, _default_level.load ( std::memory_order_relaxed ), source_file, source_line, source_function ); }
+        
+        // true if a line of the level will be kept, it is the all of cost of a filtered-out statement.
+        auto is_enabled ( const level level ) const
+        -> bool
+        {
+          return is_compiled ( level )
+              && std::uint8_t ( level ) >= std::uint8_t ( _keep_level.load ( std::memory_order_relaxed ) )
+              ;
+        }
+        
+        auto is_enabled() const
+        -> bool
+        { return is_enabled ( _default_level.load ( std::memory_order_relaxed ) ); }
+        
         auto default_level ( level level )
         -> void
         {
           rethrow();
-          _default_level = level;
+          _default_level.store ( level, std::memory_order_relaxed );
         }
         
         auto default_level() const
         -> level
         {
           rethrow();
-          return _default_level;
+          return _default_level.load ( std::memory_order_relaxed );
+        }
+        
+        auto keep_level ( level level )
+        -> void
+        {
+          rethrow();
+          _keep_level.store ( level, std::memory_order_relaxed );
+        }
+        
+        auto keep_level() const
+        -> level
+        {
+          rethrow();
+          return _keep_level.load ( std::memory_order_relaxed );
+        }
+        
+        auto hooks ( hooks_type&& hs )
+        -> void
+        {
+          rethrow();
+          publish ( _hooks, static_cast< const hooks_type* > ( new hooks_type ( std::move ( hs ) ) ) );
+        }
+        
+        auto hooks ( const hooks_type& hs )
+        -> void
+        {
+          rethrow();
+          publish ( _hooks, static_cast< const hooks_type* > ( new hooks_type ( hs ) ) );
+        }
+        
+        // a copy of the current hooks, set the modified copy with hooks( hs ) to change them
+        auto hooks( ) const
+        -> const hooks_type
+        {
+          rethrow();
+          const auto guard = _epoch.read();
+          const auto hs    = _hooks.load ( std::memory_order_acquire );
+          return hs ? *hs : hooks_type();
+        }
+        
+        auto at_destruct ( destruct_hook_type&& h ) -> void
+        {
+          rethrow();
+          std::lock_guard< std::mutex > l ( _configure_mutex );
+          _at_destruct_hook = std::move ( h );
+        }
+        
+        auto if_fatal ( log::if_fatal f )
+        -> void
+        {
+          rethrow();
+          _if_fatal.store ( f, std::memory_order_relaxed );
+#ifdef EMSCRIPTEN
+          
+          if ( f == log::if_fatal::quick_exit )
+            std::cerr
+                << "[WARNING] Emscripten is not support std::quick_exit yet,"
+            " then call std::exit if detect fatal with if_fatal flag equals quick_exit.\n"
+            ;
+            
+#endif
+        }
+        
+        auto if_fatal()
+        -> log::if_fatal
+        {
+          rethrow();
+          return _if_fatal.load ( std::memory_order_relaxed );
+        }
+        
+        auto start_time()
+        -> decltype ( _start_time )
+        {
+          rethrow();
+          return _start_time;
+        }
+        
+        auto time_appearance ( log::time_appearance a )
+        -> void
+        {
+          rethrow();
+          _time_appearance.store ( a, std::memory_order_relaxed );
+        }
+
+        auto time_format ( log::time_format a )
+        -> void
+        {
+          rethrow();
+          _time_format.store ( a, std::memory_order_relaxed );
+        }
+        
+        // async mode: the hooks are called on a dedicated writer thread,
+        //   and a LOG statement only pushes the line to a lock-free ring buffer.
+        //   capacity is rounded up to a power of two.
+        auto async
+        ( const bool              enable
+          , const std::size_t     capacity = 8192
+          , const overflow_policy policy   = overflow_policy::block
+        )
+        -> void
+        {
+          rethrow();
+#ifdef EMSCRIPTEN
+          
+          if ( enable )
+          {
+            std::cerr
+                << "[WARNING] Emscripten is not support std::thread yet,"
+                " then the async mode is not available and log_t keep the sync mode.\n"
+                ;
+            return;
+          }
+          
+#endif
+          // destruct the current writer before, it drains the all of pushed lines
+          publish ( _async, static_cast< detail::async_dispatcher_t* > ( nullptr ) );
+          
+          if ( enable )
+            publish
+            ( _async
+              , new detail::async_dispatcher_t
+                ( capacity
+                  , policy
+                  , [ this ] ( log_line_t& line ) { dispatch_async ( line ); }
+                )
+            );
         }
         
-        auto keep_level ( level level )
-        -> void
+        auto async() const
+        -> bool
         {
           rethrow();
-          _keep_level = level;
+          return _async.load ( std::memory_order_acquire ) != nullptr;
         }
         
-        auto keep_level() const
-        -> level
+        // count of lines dropped by overflow_policy::drop_newest or drop_oldest
+        auto dropped_count() const
+        -> std::uint64_t
         {
           rethrow();
-          return _keep_level;
+          const auto guard = _epoch.read();
+          const auto async = _async.load ( std::memory_order_acquire );
+          return async ? async -> dropped_count() : 0;
         }
         
-        auto hooks ( hooks_type&& hs )
+        // wait until the all of lines logged before the call are written,
+        //   and flush the buffered outputs registered to detail::flush_registry_t.
+        //   the repeats of the collapsed lines not written yet are written before.
+        auto flush()
         -> void
         {
-          rethrow();
-          _hooks = std::move ( hs );
+          append_pending_repeats();
+          
+          {
+            const auto guard = _epoch.read();
+            const auto async = _async.load ( std::memory_order_acquire );
+            
+            if ( async )
+              async -> flush();
+          }
+          
+          detail::flush_registry_t::instance().flush();
         }
         
-        auto hooks ( const hooks_type& hs )
+        // binary mode: the LOG macros encode the arguments into the line without formatting,
+        //   then write_line() of a hook ( e.g. on the async writer thread ) decodes them,
+        //   or make_binary_output_hook writes them into a compact binary file.
+        auto binary_mode ( const bool enable )
         -> void
         {
           rethrow();
-          _hooks = hs;
-        }
-        
-        auto hooks( )
-        -> hooks_type&
-        {
-          rethrow();
-          return _hooks;
+          _binary_mode.store ( enable, std::memory_order_relaxed );
         }
         
-        auto at_destruct ( destruct_hook_type&& h ) -> void
+        auto binary_mode() const
+        -> bool
         {
           rethrow();
-          _at_destruct_hook = std::move ( h );
+          return _binary_mode.load ( std::memory_order_relaxed );
         }
         
-        auto if_fatal ( log::if_fatal f )
+        // set the limits of the LOG macros of the level, limit_t() removes them.
+        //   the fatal level is not limited, then the fatal lines are never lost.
+        auto limit ( const level level, const limit_t& l )
         -> void
         {
           rethrow();
-          _if_fatal = f;
-#ifdef EMSCRIPTEN
           
-          if ( f == log::if_fatal::quick_exit )
-            std::cerr
-                << "[WARNING] Emscripten is not support std::quick_exit yet,"
-            " then call std::exit if detect fatal with if_fatal flag equals quick_exit.\n"
+          if ( level == level::none || level == level::fatal )
+            throw std::invalid_argument ( "wonderland.log: the limit of none or fatal level is not support" );
+          
+          using namespace std::chrono;
+          
+          const auto index    = std::uint8_t ( level );
+          const auto interval = l.lines_per_second > 0
+            ? std::max< std::int64_t > ( 1, duration_cast< clock_t::duration > ( duration< double > ( 1.0 / l.lines_per_second ) ).count() )
+            : 0
             ;
-            
-#endif
+          
+          std::lock_guard< std::mutex > lock ( _configure_mutex );
+          
+          auto& state = _limit_states[ index ];
+          state.interval.store ( interval, std::memory_order_relaxed );
+          state.tolerance.store ( interval * ( std::max< std::uint32_t > ( l.burst, 1 ) - 1 ), std::memory_order_relaxed );
+          state.sample.store ( std::max< std::uint32_t > ( l.sample, 1 ), std::memory_order_relaxed );
+          state.collapse.store ( l.collapse, std::memory_order_relaxed );
+          _limits[ index ] = l;
+          
+          if ( interval || l.sample > 1 || l.collapse )
+            _limited_levels.fetch_or ( 1u << index, std::memory_order_relaxed );
+          else
+            _limited_levels.fetch_and ( ~( 1u << index ), std::memory_order_relaxed );
         }
         
-        auto if_fatal()
-        -> log::if_fatal
+        auto limit ( const level level ) const
+        -> limit_t
         {
           rethrow();
-          return _if_fatal;
+          std::lock_guard< std::mutex > lock ( _configure_mutex );
+          return _limits[ std::uint8_t ( level ) ];
         }
         
-        auto start_time()
-        -> decltype ( _start_time )
+        // count of the lines suppressed by the limits of the all of call sites,
+        //   call_site_t::for_each gives the counts of each call site.
+        auto suppressed_count() const
+        -> std::uint64_t
         {
           rethrow();
-          return _start_time;
+          
+          std::uint64_t n = 0;
+          call_site_t::for_each ( [ &n ] ( const call_site_t& s ) { n += s.suppressed_count(); } );
+          return n;
         }
         
-        auto time_appearance ( log::time_appearance a )
-        -> void
-        {
-          rethrow();
-          _time_appearance = a;
-        }
-
-        auto time_format ( log::time_format a )
-        -> void
+        auto time_context()
+        -> time_context_t
         {
-          rethrow();
-          _time_format = a;
+          return
+          { _start_time
+            , time_appearance()
+            , time_format()
+            , detail::system_clock_offset_t< clock_t >::get()
+          };
         }
         
         auto time_appearance()
         -> log::time_appearance
-        { return _time_appearance; }
+        { return _time_appearance.load ( std::memory_order_relaxed ); }
 
         auto time_format()
         -> log::time_format
-        { return _time_format; }
+        { return _time_format.load ( std::memory_order_relaxed ); }
       };
       
+      // set hook to write the text layout of the lines to the stream.
+      //   the line is formatted out of the lock, and it is written with write_mutex
+      //   as like as the default hook, then the hooks can be called from the threads.
       template < class T = void >
       static auto make_string_output_hook ( std::ostream& s )
       -> log_t::hook_type
       {
         return [ &s ] ( log_line_t& log_line )
         {
-          s << log_line;
+          const detail::thread_buffer_t< detail::output_buffer_tag > r;
+          write_line ( *r, log_line );
+          
+          std::lock_guard< std::mutex > l ( write_mutex );
+          s.write ( r -> data(), static_cast< std::streamsize > ( r -> size() ) );
         };
       }
       /*
@@ -716,63 +3283,413 @@ namespace wonder_rabbit_project
         };
       }
       
+      // set hook to write the lines with an encoder, e.g. encode_json or a user defined one.
+      //   the line is encoded out of the lock, and it is written with write_mutex.
+      template < class T = void >
+      static auto make_string_output_hook ( std::ostream& s, const encoder_type encode )
+      -> log_t::hook_type
+      {
+        return [ &s, encode ] ( log_line_t& log_line )
+        {
+          const detail::thread_buffer_t< detail::output_buffer_tag > r;
+          encode ( *r, log_line, log_t::instance().time_context() );
+          
+          std::lock_guard< std::mutex > l ( write_mutex );
+          s.write ( r -> data(), static_cast< std::streamsize > ( r -> size() ) );
+        };
+      }
+      
+      template < class T = void >
+      static auto make_string_output_hook ( std::ostream& s, const encoding e )
+      -> log_t::hook_type
+      { return make_string_output_hook ( s, encoder ( e ) ); }
+      
+      // write the text layout of a line into the buffer with the time settings of log_t
       template < class T >
-      auto to_string ( const log_line_t& log_line )
-      -> std::string
+      auto write_line ( line_buffer_t& r, const log_line_t& log_line )
+      -> void
+      { write_line ( r, log_line, log_t::instance().time_context() ); }
+      
+      namespace detail
       {
-        std::ostringstream r;
+        // find the first character to escape in a JSON string, or to quote in a logfmt value.
+        //   SSE2 compares 16 characters at once, then the common strings without them cost a few instructions.
+        template < bool logfmt >
+        inline static auto find_special ( const char* p, const char* const e )
+        -> const char*
+        {
+#ifdef __SSE2__
+          const auto quote     = _mm_set1_epi8 ( '"' );
+          const auto backslash = _mm_set1_epi8 ( '\\' );
+          const auto control   = _mm_set1_epi8 ( 0x1f );
+          const auto space     = _mm_set1_epi8 ( ' ' );
+          const auto equal     = _mm_set1_epi8 ( '=' );
+          
+          for ( ; e - p >= 16; p += 16 )
+          {
+            const auto v = _mm_loadu_si128 ( reinterpret_cast< const __m128i* > ( p ) );
+            
+            auto m = _mm_or_si128 ( _mm_cmpeq_epi8 ( v, quote ), _mm_cmpeq_epi8 ( v, backslash ) );
+            // unsigned v <= 0x1f
+            m = _mm_or_si128 ( m, _mm_cmpeq_epi8 ( _mm_max_epu8 ( v, control ), control ) );
+            
+            if ( logfmt )
+              m = _mm_or_si128 ( m, _mm_or_si128 ( _mm_cmpeq_epi8 ( v, space ), _mm_cmpeq_epi8 ( v, equal ) ) );
+            
+            if ( const auto bits = _mm_movemask_epi8 ( m ) )
+              return p + __builtin_ctz ( static_cast< unsigned > ( bits ) );
+          }
+#endif
+          for ( ; p != e; ++p )
+          {
+            const auto c = static_cast< unsigned char > ( *p );
+            
+            if ( c == '"' || c == '\\' || c < 0x20 || ( logfmt && ( c == ' ' || c == '=' ) ) )
+              return p;
+          }
+          
+          return e;
+        }
+        
+        // write the string with the JSON escapes, without the quotes
+        inline static auto append_escaped ( line_buffer_t& r, const string_view_t& s )
+        -> void
+        {
+          constexpr auto hex = "0123456789abcdef";
+          
+          auto p = s.data();
+          const auto e = p + s.size();
+          
+          for ( ; ; )
+          {
+            const auto q = find_special< false > ( p, e );
+            r.append ( p, static_cast< std::size_t > ( q - p ) );
+            
+            if ( q == e )
+              return;
+            
+            switch ( *q )
+            {
+              case '"' : r.append ( "\\\"", 2 ); break;
+              case '\\': r.append ( "\\\\", 2 ); break;
+              case '\n': r.append ( "\\n", 2 ); break;
+              case '\r': r.append ( "\\r", 2 ); break;
+              case '\t': r.append ( "\\t", 2 ); break;
+              case '\b': r.append ( "\\b", 2 ); break;
+              case '\f': r.append ( "\\f", 2 ); break;
+              default:
+              {
+                const auto c = static_cast< unsigned char > ( *q );
+                const char u[] = { '\\', 'u', '0', '0', hex[ c >> 4 ], hex[ c & 0xf ] };
+                r.append ( u, sizeof( u ) );
+              }
+            }
+            
+            p = q + 1;
+          }
+        }
+        
+        inline static auto append_json_string ( line_buffer_t& r, const string_view_t& s )
+        -> void
+        {
+          r.append ( '"' );
+          append_escaped ( r, s );
+          r.append ( '"' );
+        }
         
-        constexpr auto level_string_length = 11;
-        using namespace std::chrono;
+        // a logfmt value is quoted only if it is empty or has a space, '=', '"', '\' or a control character
+        inline static auto append_logfmt_string ( line_buffer_t& r, const string_view_t& s )
+        -> void
+        {
+          if ( ! s.empty() && find_special< true > ( s.data(), s.data() + s.size() ) == s.data() + s.size() )
+            r.append ( s.data(), s.size() );
+          else
+            append_json_string ( r, s );
+        }
         
-        r << std::fixed;
+        // the value of a field, a string is written by the string writer of the encoding
+        template < class string_writer >
+        inline static auto append_field_value ( line_buffer_t& r, const field_view_t& f, string_writer write_string, const bool json )
+        -> void
+        {
+          switch ( f.type )
+          {
+            case field_type::string:
+              write_string ( r, f.string );
+              break;
+              
+            case field_type::boolean:
+              f.boolean ? r.append ( "true", 4 ) : r.append ( "false", 5 );
+              break;
+              
+            case field_type::i64:
+              r << f.i64;
+              break;
+              
+            case field_type::u64:
+              r << f.u64;
+              break;
+              
+            case field_type::f64:
+              if ( json && ! std::isfinite ( f.f64 ) )
+                r.append ( "null", 4 );
+              else
+                r.append_round_trip ( f.f64 );
+              break;
+          }
+        }
         
-        auto& l = log_t::instance( );
+        // the message of the line, the arguments of a binary line are decoded
+        template < class string_writer >
+        inline static auto append_message ( line_buffer_t& r, const log_line_t& log_line, string_writer write_string )
+        -> void
+        {
+          if ( ! log_line.binary )
+          {
+            write_string ( r, log_line.message );
+            return;
+          }
+          
+          // the message buffer of the thread is in use while a sync hook writes the line
+          const thread_buffer_t< decode_buffer_tag > decoded;
+          decode_arguments ( *decoded, log_line.message );
+          write_string ( r, decoded -> view() );
+        }
         
-        switch ( l.time_appearance( ) )
+        // the time of the line in the time_appearance of the context.
+        //   json: the iso8601 is quoted and the numbers have no unit
+        template < class T = void >
+        auto append_time ( line_buffer_t& r, const log_line_t& log_line, const time_context_t& context, const encoding e )
+        -> void
         {
-          case log::time_appearance::f64_in_seconds_from_run:
-            r << duration_cast< duration< double > > ( log_line.time - l.start_time( ) ).count();
-            break;
+          using namespace std::chrono;
+          
+          const auto system_nanoseconds
+            = static_cast< std::int64_t > ( ( duration_cast< nanoseconds > ( log_line.time.time_since_epoch() ) + context.system_clock_offset ).count() );
+          
+          const auto with_unit = e == encoding::text;
+          
+          const auto number = [ & ] ( const std::int64_t value, const char* unit )
+          {
+            r << value;
             
-          default:
-            ;
-            //r << time;
-        }
-        
-        r << " [s]\t"
-        << std::setw ( level_string_length )
-        << std::left
-        << log::to_string ( log_line.level )
-        << "\t"
-        << log_line.source_file
-        << "\t"
-        << log_line.source_line
-        << "\t"
-        << log_line.source_function
-        << "\t"
-        << log_line.message
-        << "\n"
-        ;
+            if ( with_unit )
+              r << unit;
+          };
+          
+          const auto iso8601 = [ & ] ( const int fraction_digits )
+          {
+            char b[ iso8601_cache_t::max_size ];
+            
+            if ( e == encoding::json )
+              r.append ( '"' );
+            
+            r.append ( b, render_iso8601 ( b, system_nanoseconds, context.time_format, fraction_digits ) );
+            
+            if ( e == encoding::json )
+              r.append ( '"' );
+          };
+          
+          switch ( context.time_appearance )
+          {
+            case log::time_appearance::f64_in_seconds_from_run:
+              r.append_fixed ( duration_cast< duration< double > > ( log_line.time - context.start_time ).count() );
+              
+              if ( with_unit )
+                r << " [s]";
+              
+              break;
+              
+            case log::time_appearance::i64_in_seconds_from_epoch:
+              number ( floor_divide ( system_nanoseconds, 1000000000 ), " [s]" );
+              break;
+              
+            case log::time_appearance::i64_in_milliseconds_from_epoch:
+              number ( floor_divide ( system_nanoseconds, 1000000 ), " [ms]" );
+              break;
+              
+            case log::time_appearance::i64_in_microseconds_from_epoch:
+              number ( floor_divide ( system_nanoseconds, 1000 ), " [us]" );
+              break;
+              
+            case log::time_appearance::i64_in_nanoseconds_from_epoch:
+              number ( system_nanoseconds, " [ns]" );
+              break;
+              
+            case log::time_appearance::iso8601_in_seconds:
+              iso8601 ( 0 );
+              break;
+              
+            case log::time_appearance::iso8601_in_milliseconds:
+              iso8601 ( 3 );
+              break;
+              
+            case log::time_appearance::iso8601_in_microseconds:
+              iso8601 ( 6 );
+              break;
+              
+            case log::time_appearance::iso8601_in_nanoseconds:
+              iso8601 ( 9 );
+              break;
+          }
+        }
         
-        return r.str();
+        inline static auto append_raw ( line_buffer_t& r, const string_view_t& s )
+        -> void
+        { r.append ( s.data(), s.size() ); }
       }
       
+      // write the text layout of a line into the buffer with the time settings,
+      //   it does not need log_t ( e.g. decoding the binary format in the other process ).
+      //   the fields are appended to the message as logfmt.
       template < class T >
-      auto operator<< ( std::ostream& o, const log_line_t& log_line )
-      -> std::ostream&
-      { return o << to_string ( log_line ); }
+      auto write_line ( line_buffer_t& r, const log_line_t& log_line, const time_context_t& context )
+      -> void
+      {
+        constexpr std::size_t level_string_length = 11;
+        
+        detail::append_time ( r, log_line, context, encoding::text );
+        
+        const auto level_string = log::to_string ( log_line.level );
+        
+        r << "\t"
+          << level_string
+          ;
+        
+        if ( level_string.size() < level_string_length )
+          r.append ( level_string_length - level_string.size(), ' ' );
+        
+        r << "\t"
+          << log_line.source_file
+          << "\t"
+          << log_line.source_line
+          << "\t"
+          << log_line.source_function
+          << "\t"
+          ;
+        
+        detail::append_message ( r, log_line, detail::append_raw );
+        
+        if ( log_line.fields )
+          for ( std::size_t n = 0; n < log_line.fields -> size(); ++n )
+          {
+            const auto f = ( *log_line.fields ) [ n ];
+            r.append ( ' ' );
+            r << f.key;
+            r.append ( '=' );
+            detail::append_field_value ( r, f, detail::append_logfmt_string, false );
+          }
+        
+        r << "\n";
+      }
       
-      struct null_logger_t
-      { };
+      // a line as a JSON object in a line:
+      //   {"time":...,"level":"info","file":"...","line":1,"function":"...","message":"...", the fields...}
+      template < class T >
+      auto encode_json ( line_buffer_t& r, const log_line_t& log_line, const time_context_t& context )
+      -> void
+      {
+        r.append ( "{\"time\":", 8 );
+        detail::append_time ( r, log_line, context, encoding::json );
+        r.append ( ",\"level\":\"", 10 );
+        r << log::to_string ( log_line.level );
+        r.append ( "\",\"file\":", 9 );
+        detail::append_json_string ( r, log_line.source_file );
+        r.append ( ",\"line\":", 8 );
+        r << log_line.source_line;
+        r.append ( ",\"function\":", 12 );
+        detail::append_json_string ( r, log_line.source_function );
+        r.append ( ",\"message\":", 11 );
+        detail::append_message ( r, log_line, detail::append_json_string );
+        
+        if ( log_line.fields )
+          for ( std::size_t n = 0; n < log_line.fields -> size(); ++n )
+          {
+            const auto f = ( *log_line.fields ) [ n ];
+            r.append ( ',' );
+            detail::append_json_string ( r, f.key );
+            r.append ( ':' );
+            detail::append_field_value ( r, f, detail::append_json_string, true );
+          }
+        
+        r.append ( "}\n", 2 );
+      }
+      
+      // a line as logfmt: time=... level=info file=... line=1 function=... msg=... the fields...
+      template < class T >
+      auto encode_logfmt ( line_buffer_t& r, const log_line_t& log_line, const time_context_t& context )
+      -> void
+      {
+        r.append ( "time=", 5 );
+        detail::append_time ( r, log_line, context, encoding::logfmt );
+        r.append ( " level=", 7 );
+        r << log::to_string ( log_line.level );
+        r.append ( " file=", 6 );
+        detail::append_logfmt_string ( r, log_line.source_file );
+        r.append ( " line=", 6 );
+        r << log_line.source_line;
+        r.append ( " function=", 10 );
+        detail::append_logfmt_string ( r, log_line.source_function );
+        r.append ( " msg=", 5 );
+        detail::append_message ( r, log_line, detail::append_logfmt_string );
+        
+        if ( log_line.fields )
+          for ( std::size_t n = 0; n < log_line.fields -> size(); ++n )
+          {
+            const auto f = ( *log_line.fields ) [ n ];
+            r.append ( ' ' );
+            r << f.key;
+            r.append ( '=' );
+            detail::append_field_value ( r, f, detail::append_logfmt_string, false );
+          }
+        
+        r.append ( '\n' );
+      }
+      
+      // the encoder of the encoding, a hook can use a user defined encoder of the same type too
+      template < class T >
+      auto encoder ( const encoding e )
+      -> encoder_type
+      {
+        switch ( e )
+        {
+          case encoding::text:
+            return &write_line<>;
+            
+          case encoding::json:
+            return &encode_json<>;
+            
+          case encoding::logfmt:
+            return &encode_logfmt<>;
+        }
+        
+        throw std::logic_error ( "unknown encoding value" );
+      }
       
-      template< class T >
-      auto operator<< ( const null_logger_t& _, const T& )
-      -> const null_logger_t&
+      template < class T >
+      auto to_string ( const log_line_t& log_line )
+      -> std::string
+      {
+        line_buffer_t r;
+        write_line ( r, log_line );
+        return r.view().to_string();
+      }
+      
+      // write the line through the per-thread reusable buffer without any allocation
+      template < class T >
+      auto operator<< ( std::ostream& o, const log_line_t& log_line )
+      -> std::ostream&
       {
-        return _;
+        const detail::thread_buffer_t< detail::output_buffer_tag > r;
+        write_line ( *r, log_line );
+        return o.write ( r -> data(), static_cast< std::streamsize > ( r -> size() ) );
       }
       
+      template < class T >
+      auto operator<< ( std::ostream& o, const string_view_t& s )
+      -> std::ostream&
+      { return o.write ( s.data(), static_cast< std::streamsize > ( s.size() ) ); }
+      
       template < class >
       auto to_string ( level l )
       -> std::string
@@ -832,6 +3749,126 @@ namespace wonder_rabbit_project
       auto operator<< ( std::ostream& o, if_fatal f )
       -> std::ostream&
       { return o << to_string ( f ); }
+
+      template < class T >
+      auto to_string ( time_appearance a )
+      -> std::string
+      {
+        switch ( a )
+        {
+          case time_appearance::f64_in_seconds_from_run:
+            return "f64_in_seconds_from_run";
+            
+          case time_appearance::i64_in_seconds_from_epoch:
+            return "i64_in_seconds_from_epoch";
+            
+          case time_appearance::i64_in_milliseconds_from_epoch:
+            return "i64_in_milliseconds_from_epoch";
+            
+          case time_appearance::i64_in_microseconds_from_epoch:
+            return "i64_in_microseconds_from_epoch";
+            
+          case time_appearance::i64_in_nanoseconds_from_epoch:
+            return "i64_in_nanoseconds_from_epoch";
+            
+          case time_appearance::iso8601_in_seconds:
+            return "iso8601_in_seconds";
+            
+          case time_appearance::iso8601_in_milliseconds:
+            return "iso8601_in_milliseconds";
+            
+          case time_appearance::iso8601_in_microseconds:
+            return "iso8601_in_microseconds";
+            
+          case time_appearance::iso8601_in_nanoseconds:
+            return "iso8601_in_nanoseconds";
+        }
+        
+        throw std::logic_error ( "unknown time_appearance value" );
+      }
+      
+      template < class T >
+      auto operator<< ( std::ostream& o, time_appearance a )
+      -> std::ostream&
+      { return o << to_string ( a ); }
+      
+      template < class T >
+      auto to_string ( overflow_policy p )
+      -> std::string
+      {
+        switch ( p )
+        {
+          case overflow_policy::block:
+            return "block";
+
+          case overflow_policy::drop_newest:
+            return "drop_newest";
+
+          case overflow_policy::drop_oldest:
+            return "drop_oldest";
+        }
+
+        throw std::logic_error ( "unknown overflow_policy value" );
+      }
+
+      template < class T >
+      auto operator<< ( std::ostream& o, overflow_policy p )
+      -> std::ostream&
+      { return o << to_string ( p ); }
+      
+      template < class >
+      auto to_string ( field_type t )
+      -> std::string
+      {
+        switch ( t )
+        {
+          case field_type::string:
+            return "string";
+
+          case field_type::boolean:
+            return "boolean";
+
+          case field_type::i64:
+            return "i64";
+
+          case field_type::u64:
+            return "u64";
+
+          case field_type::f64:
+            return "f64";
+        }
+
+        throw std::logic_error ( "unknown field_type value" );
+      }
+
+      template < class T >
+      auto operator<< ( std::ostream& o, field_type t )
+      -> std::ostream&
+      { return o << to_string ( t ); }
+      
+      template < class >
+      auto to_string ( encoding e )
+      -> std::string
+      {
+        switch ( e )
+        {
+          case encoding::text:
+            return "text";
+
+          case encoding::json:
+            return "json";
+
+          case encoding::logfmt:
+            return "logfmt";
+        }
+
+        throw std::logic_error ( "unknown encoding value" );
+      }
+
+      template < class T >
+      auto operator<< ( std::ostream& o, encoding e )
+      -> std::ostream&
+      { return o << to_string ( e ); }
       
     }
   }
@@ -0,0 +1,500 @@
+#pragma once
+
+#include "../log.hxx"
+
+#include <istream>
+#include <ostream>
+#include <ratio>
+
+// compact binary format of the log lines.
+//
+//   header:
+//     magic "WRPLOGB\0", u16 version, u16 byte order marker 0x0102,
+//     i64 numerator and i64 denominator of the period of clock_t,
+//     i64 ticks of the start time, i64 nanoseconds of the system_clock offset
+//   records:
+//     'D' u32 id, u32 line, u32 size, file, u32 size, function
+//         the descriptor of a call site, it is written once before the first line of the id
+//     'L' u32 id, u8 level, u8 binary, i64 ticks, u32 size, message
+//         a line of a registered call site
+//     'T' u8 level, u8 binary, i64 ticks, u32 line, u32 size, file, u32 size, function, u32 size, message
+//         a line without a call site ( e.g. log_t::operator() is called directly )
+//   the version 2 appends the fields to 'L' and 'T' after the message:
+//     u8 count, then u8 field_type, u32 size, key, and the value of each field
+//       string: u32 size, value / boolean: u8 / i64: i64 / u64: u64 / f64: f64
+//   the reader reads the version 1 and 2.
+//
+//   the all of values are written in the native byte order of the writer,
+//   then the reader does not support the files of the other byte order.
+
+namespace wonder_rabbit_project
+{
+  namespace wonderland
+  {
+    namespace log
+    {
+      namespace binary
+      {
+        constexpr char          magic[ 8 ]         = { 'W', 'R', 'P', 'L', 'O', 'G', 'B', '\0' };
+        constexpr std::uint16_t version            = 2;
+        constexpr std::uint16_t byte_order_marker  = 0x0102;
+
+        // the limits of the reader against a broken file.
+        //   max_string_size    : a string ( e.g. a message ) is longer than it is broken.
+        //   max_descriptor_gap : the ids are the call site ids of the writer process, and the call sites
+        //                        logged before the hook is made are skipped, then an id can be greater
+        //                        than the count of the read descriptors up to it.
+        constexpr std::uint32_t max_string_size    = 64 << 20;
+        constexpr std::uint32_t max_descriptor_gap = 1 << 16;
+
+        enum class record_type
+          : char
+        {
+          descriptor         = 'D'
+          , line             = 'L'
+          , line_with_source = 'T'
+        };
+
+        namespace detail
+        {
+          template < class T >
+          inline static auto put ( std::string& b, const T value )
+          -> void
+          {
+            char bytes[ sizeof( T ) ];
+            std::memcpy ( bytes, &value, sizeof( T ) );
+            b.append ( bytes, sizeof( T ) );
+          }
+
+          inline static auto put_string ( std::string& b, const string_view_t& s )
+          -> void
+          {
+            put ( b, static_cast< std::uint32_t > ( s.size() ) );
+            b.append ( s.data(), s.size() );
+          }
+
+          template < class T >
+          inline static auto get ( std::istream& i, T& value )
+          -> bool
+          {
+            char bytes[ sizeof( T ) ];
+
+            if ( ! i.read ( bytes, sizeof( T ) ) )
+              return false;
+
+            std::memcpy ( &value, bytes, sizeof( T ) );
+            return true;
+          }
+
+          // the string is read in chunks, then a broken size of a truncated file
+          //   does not allocate more than the data in the stream
+          inline static auto get_string ( std::istream& i, std::string& s )
+          -> bool
+          {
+            constexpr std::size_t chunk_size = 64 << 10;
+
+            std::uint32_t size;
+
+            if ( ! get ( i, size ) || size > max_string_size )
+              return false;
+
+            s.clear();
+
+            while ( s.size() < size )
+            {
+              const auto offset = s.size();
+              const auto n      = std::min< std::size_t > ( chunk_size, size - offset );
+
+              s.resize ( offset + n );
+
+              if ( ! i.read ( &s[ offset ], static_cast< std::streamsize > ( n ) ) )
+                return false;
+            }
+
+            return true;
+          }
+
+          template < class T = void >
+          auto put_header ( std::string& b, const time_context_t& context )
+          -> void
+          {
+            b.append ( magic, sizeof( magic ) );
+            put ( b, version );
+            put ( b, byte_order_marker );
+            put ( b, static_cast< std::int64_t > ( clock_t::period::num ) );
+            put ( b, static_cast< std::int64_t > ( clock_t::period::den ) );
+            put ( b, static_cast< std::int64_t > ( context.start_time.time_since_epoch().count() ) );
+            put ( b, static_cast< std::int64_t > ( context.system_clock_offset.count() ) );
+          }
+
+          inline static auto put_fields ( std::string& b, const fields_t* fields )
+          -> void
+          {
+            const auto size = fields ? fields -> size() : 0;
+
+            put ( b, static_cast< std::uint8_t > ( size ) );
+
+            for ( std::size_t n = 0; n < size; ++n )
+            {
+              const auto f = ( *fields )[ n ];
+
+              put ( b, f.type );
+              put_string ( b, f.key );
+
+              switch ( f.type )
+              {
+                case field_type::string:  put_string ( b, f.string ); break;
+                case field_type::boolean: put ( b, static_cast< std::uint8_t > ( f.boolean ) ); break;
+                case field_type::i64:     put ( b, f.i64 ); break;
+                case field_type::u64:     put ( b, f.u64 ); break;
+                case field_type::f64:     put ( b, f.f64 ); break;
+              }
+            }
+          }
+
+          // ticks of the period num / den of the writer to the time_point of clock_t of the reader
+          inline static auto to_time_point ( const std::int64_t ticks, const std::int64_t num, const std::int64_t den )
+          -> clock_t::time_point
+          {
+            using namespace std::chrono;
+
+            const auto nanoseconds_per_tick_numerator = num * 1000000000;
+
+            const auto ns = nanoseconds_per_tick_numerator % den == 0
+              ? ticks * ( nanoseconds_per_tick_numerator / den )
+              : static_cast< std::int64_t > ( static_cast< long double > ( ticks ) * nanoseconds_per_tick_numerator / den )
+              ;
+
+            return clock_t::time_point ( duration_cast< clock_t::duration > ( nanoseconds ( ns ) ) );
+          }
+        }
+
+        // read the lines from a binary log.
+        //   the views of a line are valid until the next call of next().
+        class reader_t
+        {
+          struct descriptor_t
+          {
+            std::string   source_file;
+            std::uint32_t source_line = 0;
+            std::string   source_function;
+          };
+
+          std::istream&               _in;
+          time_context_t              _context;
+          std::int64_t                _period_num;
+          std::int64_t                _period_den;
+          std::vector< descriptor_t > _descriptors;
+          std::size_t                 _descriptor_count = 0;
+          descriptor_t                _source;
+          std::string                 _message;
+          std::uint16_t               _version;
+          fields_t                    _fields;
+          std::string                 _key;
+          std::string                 _value;
+
+          [[noreturn]] static auto broken ( const char* what )
+          -> void
+          { throw std::runtime_error ( std::string ( "wonderland.log binary: " ) + what ); }
+
+          auto read_descriptor()
+          -> void
+          {
+            std::uint32_t id;
+            descriptor_t  d;
+
+            if
+            ( ! detail::get ( _in, id )
+              || ! detail::get ( _in, d.source_line )
+              || ! detail::get_string ( _in, d.source_file )
+              || ! detail::get_string ( _in, d.source_function )
+              || id == 0
+            )
+              broken ( "broken descriptor record" );
+
+            if ( id > _descriptor_count + max_descriptor_gap )
+              broken ( "a descriptor id is out of range" );
+
+            if ( _descriptors.size() < id )
+              _descriptors.resize ( id );
+
+            ++_descriptor_count;
+
+            _descriptors[ id - 1 ] = std::move ( d );
+          }
+
+          auto read_body ( log_line_t& line )
+          -> void
+          {
+            std::uint8_t level_value, binary;
+            std::int64_t ticks;
+
+            if
+            ( ! detail::get ( _in, level_value )
+              || ! detail::get ( _in, binary )
+              || ! detail::get ( _in, ticks )
+            )
+              broken ( "broken line record" );
+
+            line.level  = static_cast< log::level > ( level_value );
+            line.binary = binary != 0;
+            line.time   = detail::to_time_point ( ticks, _period_num, _period_den );
+          }
+
+          auto read_fields ( log_line_t& line )
+          -> void
+          {
+            _fields.clear();
+            line.fields = nullptr;
+
+            if ( _version < 2 )
+              return;
+
+            std::uint8_t count;
+
+            if ( ! detail::get ( _in, count ) )
+              broken ( "broken fields" );
+
+            for ( std::uint8_t n = 0; n < count; ++n )
+            {
+              field_type type;
+
+              if ( ! detail::get ( _in, type ) || ! detail::get_string ( _in, _key ) )
+                broken ( "broken fields" );
+
+              bool ok = true;
+
+              switch ( type )
+              {
+                case field_type::string:
+                  ok = detail::get_string ( _in, _value );
+                  _fields.add ( _key, _value );
+                  break;
+
+                case field_type::boolean:
+                {
+                  std::uint8_t v = 0;
+                  ok = detail::get ( _in, v );
+                  _fields.add ( _key, v != 0 );
+                  break;
+                }
+
+                case field_type::i64:
+                {
+                  std::int64_t v = 0;
+                  ok = detail::get ( _in, v );
+                  _fields.add ( _key, v );
+                  break;
+                }
+
+                case field_type::u64:
+                {
+                  std::uint64_t v = 0;
+                  ok = detail::get ( _in, v );
+                  _fields.add ( _key, v );
+                  break;
+                }
+
+                case field_type::f64:
+                {
+                  double v = 0;
+                  ok = detail::get ( _in, v );
+                  _fields.add ( _key, v );
+                  break;
+                }
+
+                default:
+                  ok = false;
+              }
+
+              if ( ! ok )
+                broken ( "broken fields" );
+            }
+
+            if ( ! _fields.empty() )
+              line.fields = &_fields;
+          }
+
+        public:
+          // read the header, it throws std::runtime_error if the stream is not a binary log
+          explicit reader_t ( std::istream& in )
+            : _in ( in )
+          {
+            char          m[ sizeof( magic ) ];
+            std::uint16_t v, o;
+            std::int64_t  start_ticks, offset;
+
+            if ( ! _in.read ( m, sizeof( m ) ) || std::memcmp ( m, magic, sizeof( m ) ) )
+              broken ( "it is not a binary log" );
+
+            if ( ! detail::get ( _in, v ) || ! detail::get ( _in, o ) )
+              broken ( "broken header" );
+
+            if ( o != byte_order_marker )
+              broken ( "the byte order is not support" );
+
+            if ( v == 0 || v > version )
+              broken ( "the version is not support" );
+
+            if
+            ( ! detail::get ( _in, _period_num )
+              || ! detail::get ( _in, _period_den )
+              || ! detail::get ( _in, start_ticks )
+              || ! detail::get ( _in, offset )
+              || _period_num <= 0
+              || _period_den <= 0
+            )
+              broken ( "broken header" );
+
+            _version = v;
+
+            _context.start_time          = detail::to_time_point ( start_ticks, _period_num, _period_den );
+            _context.time_appearance     = time_appearance::f64_in_seconds_from_run;
+            _context.time_format         = time_format::gmt;
+            _context.system_clock_offset = std::chrono::nanoseconds ( offset );
+          }
+
+          // the time settings of the writer, time_appearance and time_format are free to change
+          auto context()
+          -> time_context_t&
+          { return _context; }
+
+          // read the next line, false if the stream is end
+          auto next ( log_line_t& line )
+          -> bool
+          {
+            char type;
+
+            while ( _in.get ( type ) )
+            {
+              switch ( static_cast< record_type > ( type ) )
+              {
+                case record_type::descriptor:
+                  read_descriptor();
+                  continue;
+
+                case record_type::line:
+                {
+                  std::uint32_t id;
+
+                  if ( ! detail::get ( _in, id ) )
+                    broken ( "broken line record" );
+
+                  if ( id == 0 || _descriptors.size() < id )
+                    broken ( "a line refers an unknown descriptor" );
+
+                  read_body ( line );
+
+                  const auto& d = _descriptors[ id - 1 ];
+                  line.source_file     = d.source_file.c_str();
+                  line.source_line     = d.source_line;
+                  line.source_function = d.source_function.c_str();
+                  break;
+                }
+
+                case record_type::line_with_source:
+                  read_body ( line );
+
+                  if
+                  ( ! detail::get ( _in, _source.source_line )
+                    || ! detail::get_string ( _in, _source.source_file )
+                    || ! detail::get_string ( _in, _source.source_function )
+                  )
+                    broken ( "broken line record" );
+
+                  line.source_file     = _source.source_file.c_str();
+                  line.source_line     = _source.source_line;
+                  line.source_function = _source.source_function.c_str();
+                  break;
+
+                default:
+                  broken ( "unknown record type" );
+              }
+
+              if ( ! detail::get_string ( _in, _message ) )
+                broken ( "broken message" );
+
+              read_fields ( line );
+
+              line.message   = _message;
+              line.call_site = nullptr;
+              return true;
+            }
+
+            return false;
+          }
+        };
+      }
+
+      // make a hook to write the lines in the binary format ( use with LOG_BINARY_MODE( true ) ).
+      //   the header is written at the call with the time settings of log_t at the time,
+      //   then make it after LOG_START_TIME if it is changed.
+      template < class T = void >
+      static auto make_binary_output_hook ( std::ostream& s, const time_context_t& context = log_t::instance().time_context() )
+      -> log_t::hook_type
+      {
+        struct state_t
+        {
+          std::mutex          mutex;
+          std::string         record;
+          std::vector< bool > written;
+        };
+
+        const auto state = std::make_shared< state_t >();
+
+        binary::detail::put_header ( state -> record, context );
+        s.write ( state -> record.data(), static_cast< std::streamsize > ( state -> record.size() ) );
+
+        return [ &s, state ] ( log_line_t& log_line )
+        {
+          using binary::detail::put;
+          using binary::detail::put_string;
+
+          std::lock_guard< std::mutex > l ( state -> mutex );
+
+          auto& b = state -> record;
+          b.clear();
+
+          const auto id = log_line.call_site ? log_line.call_site -> id() : 0;
+
+          if ( id )
+          {
+            if ( state -> written.size() < id )
+              state -> written.resize ( id );
+
+            if ( ! state -> written[ id - 1 ] )
+            {
+              put ( b, binary::record_type::descriptor );
+              put ( b, id );
+              put ( b, log_line.call_site -> source_line() );
+              put_string ( b, log_line.call_site -> source_file() );
+              put_string ( b, log_line.call_site -> source_function() );
+              state -> written[ id - 1 ] = true;
+            }
+
+            put ( b, binary::record_type::line );
+            put ( b, id );
+          }
+          else
+            put ( b, binary::record_type::line_with_source );
+
+          put ( b, static_cast< std::uint8_t > ( log_line.level ) );
+          put ( b, static_cast< std::uint8_t > ( log_line.binary ) );
+          put ( b, static_cast< std::int64_t > ( log_line.time.time_since_epoch().count() ) );
+
+          if ( ! id )
+          {
+            put ( b, log_line.source_line );
+            put_string ( b, log_line.source_file );
+            put_string ( b, log_line.source_function );
+          }
+
+          put_string ( b, log_line.message );
+          binary::detail::put_fields ( b, log_line.fields );
+
+          s.write ( b.data(), static_cast< std::streamsize > ( b.size() ) );
+        };
+      }
+    }
+  }
+}
@@ -0,0 +1,480 @@
+#pragma once
+
+#include "../log.hxx"
+
+#ifdef _WIN32
+  #error "file_sink.hxx is not support Windows yet, use make_string_output_hook with std::ofstream alternatively."
+#endif
+
+#include <cerrno>
+#include <system_error>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+namespace wonder_rabbit_project
+{
+  namespace wonderland
+  {
+    namespace log
+    {
+      enum class fsync_policy
+      {
+        never
+        // fsync at each line of the error or fatal level
+        , on_error
+        // fsync every fsync_interval if any line is written
+        , interval
+      };
+
+      template < class T = void >
+      auto to_string ( fsync_policy p )
+      -> std::string
+      {
+        switch ( p )
+        {
+          case fsync_policy::never:
+            return "never";
+
+          case fsync_policy::on_error:
+            return "on_error";
+
+          case fsync_policy::interval:
+            return "interval";
+        }
+
+        throw std::logic_error ( "unknown fsync_policy value" );
+      }
+
+      template < class T = void >
+      auto operator<< ( std::ostream& o, fsync_policy p )
+      -> std::ostream&
+      { return o << to_string ( p ); }
+
+      struct file_sink_options_t
+      {
+        std::string path = "log.txt";
+
+        // the lines are written with writev if the buffer is full or flush_interval is elapsed.
+        //   flush_interval zero: the buffer is flushed only if it is full, at flush() and at the exit.
+        std::size_t               buffer_size    = 1 << 20;
+        std::chrono::milliseconds flush_interval { 1000 };
+
+        // rotate the file to path.1 ( path.1 to path.2, ... ) if the size or the time is exceeded.
+        //   zero: not rotate. rotated_files: number of the rotated files to keep ( 1 or more ).
+        std::uint64_t        rotation_size     = 0;
+        std::chrono::seconds rotation_interval { 0 };
+        std::size_t          rotated_files     = 8;
+
+        // append to the memory-mapped file instead of the buffer and writev.
+        //   the file grows in mmap_chunk_size and it is truncated to the written size at flush()
+        //   ( e.g. LOG_FLUSH() and the if_fatal exit paths ) and at the close,
+        //   then only a crashed process leaves the zero-filled tail of the last chunk.
+        bool        mmap            = false;
+        std::size_t mmap_chunk_size = 16 << 20;
+
+        log::fsync_policy         fsync_policy   = log::fsync_policy::never;
+        std::chrono::milliseconds fsync_interval { 1000 };
+
+        // the layout of the lines: text ( write_line ), json or logfmt
+        log::encoding encoding = log::encoding::text;
+      };
+
+      // buffered text output to a file, it is thread safe.
+      //   a flusher thread runs if flush_interval is not zero or fsync_policy is interval,
+      //   and the sink is registered to detail::flush_registry_t,
+      //   then log_t::flush(), ~log_t() and the if_fatal exit paths flush it.
+      class file_sink_t
+      {
+        const file_sink_options_t _options;
+        const encoder_type        _encode;
+
+        std::mutex              _mutex;
+        std::condition_variable _wake;
+        std::thread             _thread;
+        bool                    _stop = false;
+
+        int                 _fd = -1;
+        std::uint64_t       _size = 0;
+        clock_t::time_point _opened_time;
+        clock_t::time_point _flushed_time;
+        clock_t::time_point _synced_time;
+        bool                _unsynced = false;
+
+        std::unique_ptr< char[] > _buffer;
+        std::size_t               _buffered = 0;
+
+        char*         _map        = nullptr;
+        std::uint64_t _map_offset = 0;
+        std::size_t   _map_size   = 0;
+
+        [[noreturn]] auto fail ( const char* what ) const
+        -> void
+        { throw std::system_error ( errno, std::generic_category(), "wonderland.log file_sink: " + std::string ( what ) + " " + _options.path ); }
+
+        auto write_all ( struct iovec* iov, int count )
+        -> void
+        {
+          while ( count )
+          {
+            const auto written = ::writev ( _fd, iov, count );
+
+            if ( written < 0 )
+            {
+              if ( errno == EINTR )
+                continue;
+
+              fail ( "writev" );
+            }
+
+            auto rest = static_cast< std::size_t > ( written );
+
+            while ( count && rest >= iov -> iov_len )
+            {
+              rest -= iov -> iov_len;
+              ++iov;
+              --count;
+            }
+
+            if ( count )
+            {
+              iov -> iov_base = static_cast< char* > ( iov -> iov_base ) + rest;
+              iov -> iov_len -= rest;
+            }
+          }
+        }
+
+        // write the buffer and the data without copying with one writev
+        auto flush_locked ( const char* data = nullptr, const std::size_t size = 0 )
+        -> void
+        {
+          struct iovec iov[ 2 ];
+          int count = 0;
+
+          if ( _buffered )
+            iov[ count++ ] = { _buffer.get(), _buffered };
+
+          if ( size )
+            iov[ count++ ] = { const_cast< char* > ( data ), size };
+
+          if ( count )
+          {
+            write_all ( iov, count );
+            _buffered = 0;
+          }
+          else if ( _map )
+            ::msync ( _map, _map_size, MS_ASYNC );
+
+          _flushed_time = clock_t::now();
+        }
+
+        auto sync_locked()
+        -> void
+        {
+          if ( _map && ::msync ( _map, _map_size, MS_SYNC ) )
+            fail ( "msync" );
+
+          if ( ::fsync ( _fd ) )
+            fail ( "fsync" );
+
+          _unsynced    = false;
+          _synced_time = clock_t::now();
+        }
+
+        auto unmap()
+        -> void
+        {
+          if ( _map )
+            ::munmap ( _map, _map_size );
+
+          _map = nullptr;
+        }
+
+        // unmap and truncate the file to the written size, the next line maps it again
+        auto trim_locked()
+        -> void
+        {
+          if ( ! _map )
+            return;
+
+          unmap();
+
+          if ( ::ftruncate ( _fd, static_cast< off_t > ( _size ) ) )
+            fail ( "ftruncate" );
+        }
+
+        // map the chunk contains the end of the file and size bytes after it
+        auto remap ( const std::size_t size )
+        -> void
+        {
+          unmap();
+
+          const auto page = static_cast< std::uint64_t > ( ::sysconf ( _SC_PAGESIZE ) );
+
+          _map_offset = _size / page * page;
+
+          const auto needed = _size - _map_offset + size;
+          _map_size = static_cast< std::size_t > ( std::max< std::uint64_t > ( _options.mmap_chunk_size, ( needed + page - 1 ) / page * page ) );
+
+          if ( ::ftruncate ( _fd, static_cast< off_t > ( _map_offset + _map_size ) ) )
+            fail ( "ftruncate" );
+
+          const auto p = ::mmap ( nullptr, _map_size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, static_cast< off_t > ( _map_offset ) );
+
+          if ( p == MAP_FAILED )
+            fail ( "mmap" );
+
+          _map = static_cast< char* > ( p );
+        }
+
+        auto open_file()
+        -> void
+        {
+          const auto flags = _options.mmap
+            ? O_RDWR | O_CREAT | O_CLOEXEC
+            : O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC
+            ;
+
+          _fd = ::open ( _options.path.c_str(), flags, 0644 );
+
+          if ( _fd < 0 )
+            fail ( "open" );
+
+          struct stat s;
+
+          if ( ::fstat ( _fd, &s ) )
+            fail ( "fstat" );
+
+          _size        = static_cast< std::uint64_t > ( s.st_size );
+          _opened_time = clock_t::now();
+        }
+
+        auto close_file()
+        -> void
+        {
+          if ( _fd < 0 )
+            return;
+
+          flush_locked();
+
+          if ( _options.fsync_policy != fsync_policy::never && ( _unsynced || _map ) )
+            sync_locked();
+
+          trim_locked();
+
+          ::close ( _fd );
+          _fd = -1;
+        }
+
+        // path.( n - 1 ) to path.n, ..., path to path.1, each rename is atomic
+        auto rotate_locked()
+        -> void
+        {
+          close_file();
+
+          const auto rotated = [ this ] ( const std::size_t n )
+          { return _options.path + "." + std::to_string ( n ); };
+
+          const auto files = std::max< std::size_t > ( _options.rotated_files, 1 );
+
+          ::unlink ( rotated ( files ).c_str() );
+
+          for ( auto n = files - 1; n; --n )
+            ::rename ( rotated ( n ).c_str(), rotated ( n + 1 ).c_str() );
+
+          if ( ::rename ( _options.path.c_str(), rotated ( 1 ).c_str() ) )
+            fail ( "rename" );
+
+          open_file();
+        }
+
+        auto write_locked ( const char* data, const std::size_t size, const log::level level, const clock_t::time_point time )
+        -> void
+        {
+          if
+          ( _size
+            && ( ( _options.rotation_size && _size + size > _options.rotation_size )
+                 || ( _options.rotation_interval.count() && time - _opened_time >= _options.rotation_interval )
+               )
+          )
+            rotate_locked();
+
+          if ( _options.mmap )
+          {
+            if ( ! _map || _size + size > _map_offset + _map_size )
+              remap ( size );
+
+            std::memcpy ( _map + ( _size - _map_offset ), data, size );
+          }
+          else if ( _buffered + size <= _options.buffer_size )
+          {
+            std::memcpy ( _buffer.get() + _buffered, data, size );
+            _buffered += size;
+          }
+          else
+            flush_locked ( data, size );
+
+          _size    += size;
+          _unsynced = true;
+
+          if ( level >= log::level::error && _options.fsync_policy == fsync_policy::on_error )
+          {
+            flush_locked();
+            sync_locked();
+          }
+          else if ( _options.flush_interval.count() && time - _flushed_time >= _options.flush_interval )
+            flush_locked();
+        }
+
+        // the flusher thread, it writes the buffer and fsync at the intervals while no lines come
+        auto run()
+        -> void
+        {
+          using namespace std::chrono;
+
+          auto period = _options.flush_interval;
+
+          if ( _options.fsync_policy == fsync_policy::interval && ( ! period.count() || _options.fsync_interval < period ) )
+            period = _options.fsync_interval;
+
+          period = std::max ( period, milliseconds ( 1 ) );
+
+          std::unique_lock< std::mutex > l ( _mutex );
+
+          while ( ! _wake.wait_for ( l, period, [ this ] { return _stop; } ) )
+            try
+            {
+              const auto now = clock_t::now();
+
+              if ( _buffered && _options.flush_interval.count() && now - _flushed_time >= _options.flush_interval )
+                flush_locked();
+
+              if ( _unsynced && _options.fsync_policy == fsync_policy::interval && now - _synced_time >= _options.fsync_interval )
+              {
+                flush_locked();
+                sync_locked();
+              }
+            }
+            catch ( const std::exception& e )
+            {
+              std::cerr << "[WARNING] file_sink_t flusher thread: " << e.what() << "\n";
+            }
+        }
+
+      public:
+        explicit file_sink_t ( file_sink_options_t options )
+          : _options ( std::move ( options ) )
+          , _encode ( encoder ( _options.encoding ) )
+          , _buffer ( _options.mmap ? nullptr : new char[ std::max< std::size_t > ( _options.buffer_size, 1 ) ] )
+        {
+          open_file();
+
+          _flushed_time = _synced_time = _opened_time;
+
+          if ( _options.flush_interval.count() || _options.fsync_policy == fsync_policy::interval )
+            _thread = std::thread ( [ this ] { run(); } );
+
+          detail::flush_registry_t::instance().add ( this, [ this ] { flush(); } );
+        }
+
+        file_sink_t ( const file_sink_t& ) = delete;
+        auto operator= ( const file_sink_t& ) -> void = delete;
+
+        ~file_sink_t()
+        {
+          detail::flush_registry_t::instance().remove ( this );
+
+          {
+            std::lock_guard< std::mutex > l ( _mutex );
+            _stop = true;
+            _wake.notify_one();
+          }
+
+          if ( _thread.joinable() )
+            _thread.join();
+
+          try
+          {
+            std::lock_guard< std::mutex > l ( _mutex );
+            close_file();
+          }
+          catch ( const std::exception& e )
+          {
+            std::cerr << "[WARNING] file_sink_t destructor: " << e.what() << "\n";
+          }
+        }
+
+        // write the line in the encoding of the options, it is formatted out of the lock
+        auto write ( const log_line_t& log_line )
+        -> void
+        {
+          const detail::thread_buffer_t< detail::output_buffer_tag > r;
+          _encode ( *r, log_line, log_t::instance().time_context() );
+
+          std::lock_guard< std::mutex > l ( _mutex );
+          write_locked ( r -> data(), r -> size(), log_line.level, log_line.time );
+        }
+
+        // write the buffered lines to the file, and truncate the mapped file to the written size.
+        //   the flush registry calls it, then the exit paths including std::quick_exit
+        //   do not leave the zero-filled tail.
+        auto flush()
+        -> void
+        {
+          std::lock_guard< std::mutex > l ( _mutex );
+          flush_locked();
+          trim_locked();
+        }
+
+        // flush and fsync regardless of fsync_policy
+        auto sync()
+        -> void
+        {
+          std::lock_guard< std::mutex > l ( _mutex );
+          flush_locked();
+          sync_locked();
+        }
+
+        auto rotate()
+        -> void
+        {
+          std::lock_guard< std::mutex > l ( _mutex );
+          rotate_locked();
+        }
+
+        auto options() const
+        -> const file_sink_options_t&
+        { return _options; }
+      };
+
+      // make a hook to write the lines to a file_sink_t,
+      //   keep the sink if you want to call flush(), sync() or rotate() of it.
+      template < class T = void >
+      static auto make_file_output_hook ( const std::shared_ptr< file_sink_t >& sink )
+      -> log_t::hook_type
+      {
+        return [ sink ] ( log_line_t& log_line )
+        {
+          sink -> write ( log_line );
+        };
+      }
+
+      template < class T = void >
+      static auto make_file_output_hook ( file_sink_options_t options )
+      -> log_t::hook_type
+      { return make_file_output_hook ( std::make_shared< file_sink_t > ( std::move ( options ) ) ); }
+
+      template < class T = void >
+      static auto make_file_output_hook ( const std::string& path )
+      -> log_t::hook_type
+      {
+        file_sink_options_t options;
+        options.path = path;
+        return make_file_output_hook ( std::move ( options ) );
+      }
+    }
+  }
+}
@@ -0,0 +1,123 @@
+// allocation test: a LOG statement does not allocate in the steady state.
+//   the replaced operator new counts the allocations of the all of threads,
+//   then the writer thread of the async mode is counted too.
+//
+//   the steady state is after a warm up with the same statements:
+//   - sync  : the per-thread buffers are allocated at the first line of the thread.
+//   - async : each slot of the ring keeps the capacity of the longest message it had,
+//             then the ring is warmed up with the lines of the same size.
+
+#include <wonder_rabbit_project/wonderland/log.hxx>
+
+#include <fstream>
+#include <new>
+
+namespace
+{
+  std::atomic< std::uint64_t > allocations ( 0 );
+}
+
+auto operator new ( std::size_t size )
+-> void*
+{
+  allocations.fetch_add ( 1, std::memory_order_relaxed );
+
+  if ( auto p = std::malloc ( size ? size : 1 ) )
+    return p;
+
+  throw std::bad_alloc();
+}
+
+auto operator delete ( void* p ) noexcept
+-> void
+{ std::free ( p ); }
+
+auto operator delete ( void* p, std::size_t ) noexcept
+-> void
+{ std::free ( p ); }
+
+namespace
+{
+  using namespace wonder_rabbit_project::wonderland;
+
+  constexpr std::size_t lines          = 10000;
+  constexpr std::size_t async_capacity = 256;
+
+  // run the statement as the warm up and then count the allocations of the lines
+  template < class F >
+  auto count ( const char* name, F statement )
+  -> bool
+  {
+    for ( std::size_t n = 0; n < async_capacity * 2; ++n )
+      statement ( n );
+
+    LOG_FLUSH();
+
+    const auto before = allocations.load();
+
+    for ( std::size_t n = 0; n < lines; ++n )
+      statement ( n );
+
+    LOG_FLUSH();
+
+    const auto counted = allocations.load() - before;
+
+    std::printf ( "allocation: %-12s %llu allocations in %zu lines\n"
+      , name
+      , static_cast< unsigned long long > ( counted )
+      , lines
+    );
+
+    return counted == 0;
+  }
+
+  // the numbers are fixed width, then the lines of a statement are the same size
+  auto text ( const std::size_t n )
+  -> void
+  { LOGI << "request " << ( 100000 + n ) << " " << 1.5 << " " << true << " done in the steady state"; }
+
+  auto fields ( const std::size_t n )
+  -> void
+  {
+    static const std::string name = "wonderland user name longer than the small string";
+    LOGI.kv ( "user", 100000 + n ).kv ( "latency_us", 12.5 ).kv ( "ok", true ).kv ( "name", name ) << "request done";
+  }
+}
+
+auto main()
+-> int
+{
+  static std::ofstream null_file ( "/dev/null" );
+  std::ostream& null_stream = null_file;
+
+  LOG_HOOKS( { log::make_string_output_hook ( null_stream ) } );
+
+  bool passed = true;
+
+  passed &= count ( "sync text", text );
+
+  passed &= count ( "sync fields", fields );
+
+  LOG_HOOKS( { log::make_string_output_hook ( null_stream, log::encoding::json ) } );
+  passed &= count ( "sync json", fields );
+
+  LOG_HOOKS( { log::make_string_output_hook ( null_stream ) } );
+  LOG_TIME_APPEARANCE( log::time_appearance::iso8601_in_microseconds );
+  passed &= count ( "sync iso", text );
+  LOG_TIME_APPEARANCE( log::time_appearance::f64_in_seconds_from_run );
+
+  LOG_BINARY_MODE( true );
+  passed &= count ( "sync binary", text );
+  LOG_BINARY_MODE( false );
+
+  LOG_ASYNC( true, async_capacity, log::overflow_policy::block );
+  passed &= count ( "async text", text );
+  passed &= count ( "async fields", fields );
+  LOG_ASYNC( false );
+
+  if ( ! passed )
+  {
+    std::fprintf ( stderr, "allocation: a LOG statement allocates in the steady state\n" );
+    return EXIT_FAILURE;
+  }
+}
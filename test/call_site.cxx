@@ -0,0 +1,52 @@
+// call site test: the instantiations of a function template have the own descriptors,
+//   then the descriptor of a line has the function of the line ( e.g. for the binary format ).
+
+#include <wonder_rabbit_project/wonderland/log.hxx>
+
+#include <set>
+
+namespace
+{
+  using namespace wonder_rabbit_project::wonderland;
+
+  std::set< const log::call_site_t* > sites;
+  bool mismatched = false;
+
+  template < class T >
+  auto f ( const T& v )
+  -> void
+  { LOGI << v; }
+}
+
+auto main()
+-> int
+{
+  LOG_HOOKS
+  ( { [ ] ( log::log_line_t& line )
+      {
+        if ( ! line.call_site )
+          return;
+
+        sites.insert ( line.call_site );
+
+        if ( std::strcmp ( line.call_site -> source_function(), line.source_function ) != 0 )
+        {
+          std::fprintf ( stderr, "call_site: %s is written as %s\n", line.source_function, line.call_site -> source_function() );
+          mismatched = true;
+        }
+      }
+    }
+  );
+
+  f ( 1 );
+  f ( 2.5 );
+  f ( std::string ( "wonderland" ) );
+  f ( 3 );
+
+  LOG_HOOKS( log::log_t::hooks_type() );
+
+  std::printf ( "call_site: %zu descriptors\n", sites.size() );
+
+  if ( mismatched || sites.size() != 3 )
+    return EXIT_FAILURE;
+}
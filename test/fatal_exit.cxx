@@ -0,0 +1,77 @@
+// fatal exit test: a hook of the async writer thread logs a fatal line with if_fatal::exit,
+//   then ~log_t() runs in the reader section of the writer thread.
+//   it must not throw, and the rest of lines in the ring and the logout line are written.
+//   the handler of std::atexit is registered before the instance, then it runs after ~log_t().
+
+#include <wonder_rabbit_project/wonderland/log.hxx>
+
+namespace
+{
+  using namespace wonder_rabbit_project::wonderland;
+
+  constexpr std::size_t rest_lines = 100;
+
+  std::atomic< std::size_t > written_rest ( 0 );
+  std::atomic< bool >        written_logout ( false );
+  std::atomic< bool >        pushed_rest ( false );
+
+  auto starts_with ( const log::string_view_t& s, const char* prefix )
+  -> bool
+  {
+    const auto size = std::strlen ( prefix );
+    return s.size() >= size && std::memcmp ( s.data(), prefix, size ) == 0;
+  }
+
+  auto check()
+  -> void
+  {
+    std::printf ( "fatal_exit: %zu / %zu rest lines, logout %s\n"
+      , written_rest.load()
+      , rest_lines
+      , written_logout.load() ? "written" : "not written"
+    );
+
+    std::fflush ( stdout );
+    std::_Exit ( written_rest.load() == rest_lines && written_logout.load() ? EXIT_SUCCESS : EXIT_FAILURE );
+  }
+}
+
+auto main()
+-> int
+{
+  std::atexit ( check );
+
+  LOG_IF_FATAL( log::if_fatal::exit );
+
+  LOG_HOOKS
+  ( { [ ] ( log::log_line_t& line )
+      {
+        if ( starts_with ( line.message, "rest" ) )
+          written_rest.fetch_add ( 1 );
+        else if ( starts_with ( line.message, "logout time" ) )
+          written_logout.store ( true );
+        else if ( starts_with ( line.message, "trigger" ) )
+        {
+          // the rest of lines are in the ring before the exit
+          while ( ! pushed_rest.load() )
+            std::this_thread::yield();
+
+          LOGF << "fatal in a hook of the writer thread";
+        }
+      }
+    }
+  );
+
+  LOG_ASYNC( true, 1024, log::overflow_policy::block );
+
+  LOGI << "trigger";
+
+  for ( std::size_t n = 0; n < rest_lines; ++n )
+    LOGI << "rest " << n;
+
+  pushed_rest.store ( true );
+
+  // the writer thread exits the process
+  while ( true )
+    std::this_thread::sleep_for ( std::chrono::seconds ( 1 ) );
+}
@@ -0,0 +1,170 @@
+// stress test of the thread safety: the producer threads log while a thread changes
+//   the hooks, the levels, the async mode, the binary mode and the limits.
+//   it fails if a line is lost in the block policy or a setting is not applied,
+//   and the data races are found by the build with -fsanitize=thread.
+
+#include <wonder_rabbit_project/wonderland/log.hxx>
+
+#include <fstream>
+
+namespace
+{
+  using namespace wonder_rabbit_project::wonderland;
+
+  std::atomic< std::uint64_t > counted_lines ( 0 );
+
+  auto fail ( const char* what )
+  -> int
+  {
+    std::fprintf ( stderr, "stress: %s\n", what );
+    return EXIT_FAILURE;
+  }
+
+  auto counting_hook()
+  -> log::log_t::hook_type
+  { return [ ] ( log::log_line_t& ) { counted_lines.fetch_add ( 1, std::memory_order_relaxed ); }; }
+
+  auto produce ( const std::atomic< bool >& stop, const std::size_t t )
+  -> void
+  {
+    const std::string name = "wonderland";
+
+    for ( std::uint64_t n = 0; ! stop.load ( std::memory_order_relaxed ); ++n )
+    {
+      switch ( n % 4 )
+      {
+        case 0: LOGI << "thread " << t << " line " << n << " " << 1.5 << " " << name; break;
+        case 1: LOGW.kv ( "thread", t ).kv ( "line", n ).kv ( "name", name ) << "fields"; break;
+        case 2: LOGD << "debug " << n; break;
+        case 3: LOGE << "repeated"; break;
+      }
+    }
+  }
+}
+
+auto main()
+-> int
+{
+  static std::ofstream null_file ( "/dev/null" );
+  std::ostream& null_stream = null_file;
+
+  const log::log_t::hooks_type text_hooks { counting_hook(), log::make_string_output_hook ( null_stream ) };
+  const log::log_t::hooks_type json_hooks { counting_hook(), log::make_string_output_hook ( null_stream, log::encoding::json ) };
+  const log::log_t::hooks_type logfmt_hooks { counting_hook(), log::make_string_output_hook ( null_stream, log::encoding::logfmt ) };
+
+  LOG_HOOKS( text_hooks );
+
+  // a hook cannot change the settings, it throws std::logic_error in the reader section
+  {
+    bool thrown = false;
+
+    LOG_HOOKS
+    ( log::log_t::hooks_type
+      { [ &thrown ] ( log::log_line_t& )
+        {
+          try
+          {
+            LOG_HOOKS( log::log_t::hooks_type() );
+          }
+          catch ( const std::logic_error& )
+          {
+            thrown = true;
+          }
+        }
+      }
+    );
+
+    LOGI << "change the hooks in a hook";
+
+    if ( ! thrown )
+      return fail ( "a hook changed the hooks" );
+  }
+
+  // a hook of the writer thread can use the getters while the async mode is disabled
+  {
+    LOG_HOOKS( { [ ] ( log::log_line_t& ) { LOG_INSTANCE.limit ( log::level::warn ); } } );
+    LOG_ASYNC( true, 64, log::overflow_policy::block );
+
+    for ( std::size_t n = 0; n < 1000; ++n )
+      LOGI << "getter in a hook " << n;
+
+    LOG_ASYNC( false );
+  }
+
+  LOG_HOOKS( text_hooks );
+
+  const auto threads = std::max< std::size_t > ( 4, std::thread::hardware_concurrency() );
+
+  std::atomic< bool >        stop ( false );
+  std::vector< std::thread > producers;
+
+  for ( std::size_t t = 0; t < threads; ++t )
+    producers.emplace_back ( [ &stop, t ] { produce ( stop, t ); } );
+
+  log::limit_t limit;
+  limit.lines_per_second = 10000;
+  limit.burst            = 100;
+  limit.sample           = 2;
+  limit.collapse         = 10;
+
+  for ( std::size_t round = 0; round < 200; ++round )
+  {
+    switch ( round % 3 )
+    {
+      case 0: LOG_HOOKS( text_hooks ); break;
+      case 1: LOG_HOOKS( json_hooks ); break;
+      case 2: LOG_HOOKS( logfmt_hooks ); break;
+    }
+
+    LOG_KEEP_LEVEL( round % 5 == 0 ? log::level::warn : log::level::debug );
+    LOG_BINARY_MODE( round % 2 == 0 );
+    LOG_TIME_APPEARANCE( round % 4 == 0 ? log::time_appearance::iso8601_in_microseconds : log::time_appearance::f64_in_seconds_from_run );
+    LOG_LIMIT( log::level::error, round % 7 == 0 ? log::limit_t() : limit );
+
+    switch ( round % 6 )
+    {
+      case 0: LOG_ASYNC( false ); break;
+      case 1: LOG_ASYNC( true, 1024, log::overflow_policy::block ); break;
+      case 2: LOG_ASYNC( true, 256, log::overflow_policy::drop_newest ); break;
+      case 3: LOG_ASYNC( true, 256, log::overflow_policy::drop_oldest ); break;
+      case 4: LOG_FLUSH(); break;
+      case 5: break;
+    }
+
+    std::this_thread::sleep_for ( std::chrono::milliseconds ( 1 ) );
+  }
+
+  stop.store ( true );
+
+  for ( auto& p : producers )
+    p.join();
+
+  // the block policy and the sync mode do not lose the lines
+  LOG_ASYNC( true, 64, log::overflow_policy::block );
+  LOG_KEEP_LEVEL( log::level::debug );
+  LOG_HOOKS( text_hooks );
+  LOG_FLUSH();
+
+  const auto before = counted_lines.load();
+
+  for ( std::size_t n = 0; n < 10000; ++n )
+    LOGI << "drain " << n;
+
+  LOG_FLUSH();
+
+  if ( counted_lines.load() - before != 10000 )
+    return fail ( "lines are lost in overflow_policy::block" );
+
+  LOG_ASYNC( false );
+
+  if ( LOG_INSTANCE.async() )
+    return fail ( "the async mode is not disabled" );
+
+  std::printf ( "stress: %llu lines, %llu suppressed\n"
+    , static_cast< unsigned long long > ( counted_lines.load() )
+    , static_cast< unsigned long long > ( LOG_SUPPRESSED_COUNT() )
+  );
+
+  LOG_LIMIT( log::level::error, log::limit_t() );
+  LOG_HOOKS( log::log_t::hooks_type() );
+}